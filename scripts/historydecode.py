@@ -0,0 +1,67 @@
+#
+# avr industrial weight checker t01 - sample history decoder
+#
+# copyright (c) Davide Gironi, 2021
+#
+# Released under GPLv3.
+# Please refer to LICENSE file for licensing information.
+#
+# Decodes the sample history sent by the 'h' telemetry command.
+# The dump is a header line with the count, pre, first and len fields,
+# followed by lines of hex bytes. The bytes are the differences between
+# consecutive samples, zig-zag encoded and written as varints.
+# Prints one sample per line: index, phase (pre or post trigger), value.
+#
+# usage: historydecode.py [dumpfile], reads stdin if no file is given
+#
+
+import sys
+
+
+def readdump(lines):
+    header = None
+    data = bytearray()
+    for line in lines:
+        line = line.strip()
+        if not line:
+            continue
+        if header is None:
+            if line.startswith("count="):
+                header = dict(field.split("=") for field in line.split())
+            continue
+        data += bytes.fromhex(line)
+        if len(data) >= int(header["len"]):
+            break
+    if header is None:
+        raise ValueError("history header not found")
+    return header, data[:int(header["len"])]
+
+
+def decode(first, data):
+    samples = [first]
+    z = 0
+    shift = 0
+    for b in data:
+        z |= (b & 0x7F) << shift
+        shift += 7
+        if b & 0x80:
+            continue
+        samples.append(samples[-1] + ((z >> 1) ^ -(z & 1)))
+        z = 0
+        shift = 0
+    return samples
+
+
+def main():
+    f = open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin
+    header, data = readdump(f)
+    samples = decode(int(header["first"]), data)
+    if len(samples) != int(header["count"]):
+        sys.stderr.write("warning: %d samples decoded, %s expected\n" % (len(samples), header["count"]))
+    pre = int(header["pre"])
+    for i, sample in enumerate(samples):
+        print("%d %s %d" % (i, "pre" if i < pre else "post", sample))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,354 @@
+/*
+hx711 simavr harness 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + runs the test firmware on a simavr atmega8 wired to a hx711 model,
+    the model converts every HX711SIM_PERIODUS, pulls DOUT low when a
+    conversion is ready and shifts out a known word on the SCK rising
+    edges, an spi transfer is taken as 8 SCK pulses
+  + the pulses after the 24 bits (25 to 27) select the gain and channel of
+    the next conversions, as on the chip
+  + the checks: every read has 24 bits plus 1 to 3 gain pulses, every
+    value sent back by the firmware is the word of a conversion with the
+    test gain, preceded by HX711SIM_SETTLEPERIODS conversions on the same
+    gain and channel, the blocking reads cut a channel B burst within
+    HX711SIM_SETTLEPERIODS+2 conversions, the channel B value is a settled
+    channel B conversion
+  + usage: hx711sim firmware.elf boardrev, returns 0 if the checks pass
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_time.h"
+#include "sim_cycle_timers.h"
+#include "avr_ioport.h"
+#include "avr_spi.h"
+#include "avr_uart.h"
+
+#include "hx711sim.h"
+
+//frequency of the board
+#define HX711SIM_FREQUENCY 8000000
+
+//conversions kept, and simulated time limit (s)
+#define HX711SIM_CONVERSIONS 1024
+#define HX711SIM_TIMEOUTS 10
+
+//sck low time (us) that ends a read
+#define HX711SIM_READENDUS 20
+
+//gain pulses, the selection of a conversion
+#define HX711SIM_SELECTA128 1
+#define HX711SIM_SELECTB32 2
+#define HX711SIM_SELECTA64 3
+
+//hx711 model
+typedef struct {
+	avr_t *avr;
+	avr_irq_t *dtirq;
+	avr_irq_t *spiinirq;
+	uint8_t sck; //last sck level
+	uint8_t ready; //a conversion is ready, dout is low
+	uint8_t clocks; //sck pulses of the read in progress
+	avr_cycle_count_t clocktime; //cycle of the last sck pulse
+	uint32_t word; //word of the conversion being read
+	uint8_t select; //selection of the next conversions, set by the last read
+	uint16_t conversions; //conversions done
+	uint8_t selects[HX711SIM_CONVERSIONS]; //selection of each conversion
+	uint16_t missed; //conversions overwritten before a read
+	uint16_t errors;
+	uint8_t uart[HX711SIM_UARTBYTES];
+	uint16_t uartlen;
+} hx711sim_t;
+
+/**
+ * word of a conversion, off the 0x7FFFFF and 0x800000 rails
+ */
+static uint32_t hx711sim_word(uint16_t conversion) {
+	uint32_t word = (0x0ABCDEUL + (uint32_t)conversion*0x21F3B7UL) & 0xFFFFFF;
+	if(word == 0x7FFFFF || word == 0x800000)
+		word ^= 1;
+	return word;
+}
+
+/**
+ * a sck rising edge, return the dout level shifted out
+ */
+static uint8_t hx711sim_clock(hx711sim_t *m) {
+	uint8_t bit = 1;
+
+	if(m->clocks == 0 && !m->ready) {
+		printf("error: sck pulse with no conversion ready\n");
+		m->errors++;
+		return bit;
+	}
+	m->clocks++;
+	m->clocktime = m->avr->cycle;
+	if(m->clocks <= 24) {
+		bit = (m->word >> (24 - m->clocks)) & 1;
+	} else if(m->clocks == 25) {
+		//dout goes high on the 25th pulse
+		m->ready = 0;
+	}
+	avr_raise_irq(m->dtirq, bit);
+	return bit;
+}
+
+/**
+ * close the read in progress, its pulses select the next conversions
+ */
+static void hx711sim_endread(hx711sim_t *m) {
+	if(m->clocks < 25 || m->clocks > 27) {
+		printf("error: read of %u pulses, 25 to 27 expected\n", m->clocks);
+		m->errors++;
+	} else {
+		m->select = m->clocks - 24;
+	}
+	m->clocks = 0;
+}
+
+/**
+ * sck pin hook
+ */
+static void hx711sim_sck(struct avr_irq_t *irq, uint32_t value, void *param) {
+	hx711sim_t *m = (hx711sim_t *)param;
+
+	value = value ? 1 : 0;
+	if(value && !m->sck)
+		hx711sim_clock(m);
+	m->sck = value;
+}
+
+/**
+ * spi transfer hook, 8 sck pulses
+ */
+static void hx711sim_spi(struct avr_irq_t *irq, uint32_t value, void *param) {
+	hx711sim_t *m = (hx711sim_t *)param;
+	uint8_t byte = 0;
+	uint8_t i = 0;
+
+	for(i=0; i<8; i++)
+		byte = (byte<<1) | hx711sim_clock(m);
+	avr_raise_irq(m->spiinirq, byte);
+}
+
+/**
+ * uart hook, collect the bytes sent by the firmware
+ */
+static void hx711sim_uart(struct avr_irq_t *irq, uint32_t value, void *param) {
+	hx711sim_t *m = (hx711sim_t *)param;
+
+	if(m->uartlen < HX711SIM_UARTBYTES)
+		m->uart[m->uartlen++] = (uint8_t)value;
+	else
+		m->errors++;
+}
+
+/**
+ * conversion timer, a new word is ready
+ */
+static avr_cycle_count_t hx711sim_convert(struct avr_t *avr, avr_cycle_count_t when, void *param) {
+	hx711sim_t *m = (hx711sim_t *)param;
+
+	//a read in progress holds the output register, the gain pulses end
+	//the read when sck stays low for HX711SIM_READENDUS
+	if(m->clocks > 0 && (m->clocks < 25 || avr->cycle - m->clocktime < avr_usec_to_cycles(avr, HX711SIM_READENDUS)))
+		return when + avr_usec_to_cycles(avr, HX711SIM_READENDUS);
+	if(m->clocks)
+		hx711sim_endread(m);
+	if(m->ready)
+		m->missed++;
+
+	if(m->conversions < HX711SIM_CONVERSIONS) {
+		m->selects[m->conversions] = m->select;
+		m->word = hx711sim_word(m->conversions);
+		m->conversions++;
+	}
+	m->ready = 1;
+	avr_raise_irq(m->dtirq, 0);
+
+	return when + avr_usec_to_cycles(avr, HX711SIM_PERIODUS);
+}
+
+/**
+ * find the conversion of a value sent by the firmware, after a conversion
+ */
+static int hx711sim_find(hx711sim_t *m, uint32_t value, int after) {
+	int i = 0;
+
+	for(i=after+1; i<m->conversions; i++) {
+		if((hx711sim_word(i) ^ 0x800000) == value)
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * check a conversion is settled, the ones before it have the same selection
+ */
+static uint8_t hx711sim_settled(hx711sim_t *m, int conversion) {
+	int i = 0;
+
+	for(i=1; i<=HX711SIM_SETTLEPERIODS && conversion-i >= 0; i++) {
+		if(m->selects[conversion-i] != m->selects[conversion])
+			return 0;
+	}
+	return 1;
+}
+
+/**
+ * get a value sent by the firmware
+ */
+static uint32_t hx711sim_uartvalue(hx711sim_t *m, uint16_t *pos, uint8_t bytes) {
+	uint32_t value = 0;
+
+	while(bytes--)
+		value = (value<<8) | m->uart[(*pos)++];
+	return value;
+}
+
+/**
+ * check the values sent by the firmware
+ */
+static void hx711sim_check(hx711sim_t *m) {
+	uint16_t pos = 0;
+	uint32_t value = 0;
+	int last = -1;
+	int conversion = 0;
+	uint16_t i = 0;
+
+	if(m->uartlen != HX711SIM_UARTBYTES) {
+		printf("error: %u uart bytes, %u expected\n", m->uartlen, HX711SIM_UARTBYTES);
+		m->errors++;
+		return;
+	}
+
+	//channel A reads
+	for(i=0; i<HX711SIM_READS+HX711SIM_READSCUT; i++) {
+		value = hx711sim_uartvalue(m, &pos, 3);
+		conversion = hx711sim_find(m, value, last);
+		if(conversion < 0) {
+			printf("error: read %u value 0x%06X is not a conversion word\n", i, value);
+			m->errors++;
+			continue;
+		}
+		if(m->selects[conversion] != HX711SIM_GAIN) {
+			printf("error: read %u conversion %d has selection %u\n", i, conversion, m->selects[conversion]);
+			m->errors++;
+		}
+		if(!hx711sim_settled(m, conversion)) {
+			printf("error: read %u conversion %d is not settled\n", i, conversion);
+			m->errors++;
+		}
+		if(i >= HX711SIM_READS && last >= 0 && conversion - last > HX711SIM_SETTLEPERIODS+2) {
+			printf("error: blocking read %u waited %d conversions\n", i, conversion - last);
+			m->errors++;
+		}
+		last = conversion;
+	}
+
+	//channel B
+	value = hx711sim_uartvalue(m, &pos, 3);
+	conversion = hx711sim_find(m, value, -1);
+	if(conversion < 0 || m->selects[conversion] != HX711SIM_SELECTB32 || !hx711sim_settled(m, conversion)) {
+		printf("error: channel B value 0x%06X is not a settled channel B conversion\n", value);
+		m->errors++;
+	}
+	value = hx711sim_uartvalue(m, &pos, 2);
+	if(value == 0) {
+		printf("error: no channel B samples\n");
+		m->errors++;
+	}
+	printf("channel B samples %u\n", value);
+
+	//faults
+	value = hx711sim_uartvalue(m, &pos, 1);
+	if(value != 0) {
+		printf("error: faults 0x%02X\n", value);
+		m->errors++;
+	}
+}
+
+int main(int argc, char *argv[]) {
+	elf_firmware_t firmware;
+	hx711sim_t m;
+	avr_t *avr = NULL;
+	int state = cpu_Running;
+	uint32_t flags = 0;
+	uint8_t dtpin = 0;
+	uint8_t sckpin = 0;
+
+	if(argc < 3) {
+		printf("usage: %s firmware.elf boardrev\n", argv[0]);
+		return 2;
+	}
+	//pins of the board revisions, as board.h
+	if(atoi(argv[2]) == 2) {
+		dtpin = 4;
+		sckpin = 5;
+	} else {
+		dtpin = 0;
+		sckpin = 1;
+	}
+
+	memset(&firmware, 0, sizeof(firmware));
+	if(elf_read_firmware(argv[1], &firmware) != 0) {
+		printf("error: can not read %s\n", argv[1]);
+		return 2;
+	}
+	avr = avr_make_mcu_by_name("atmega8");
+	if(!avr) {
+		printf("error: no atmega8 core\n");
+		return 2;
+	}
+	avr_init(avr);
+	firmware.frequency = HX711SIM_FREQUENCY;
+	avr_load_firmware(avr, &firmware);
+
+	//wire the model
+	memset(&m, 0, sizeof(m));
+	m.avr = avr;
+	m.select = HX711SIM_SELECTA128;
+	m.sck = 0;
+	m.dtirq = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), dtpin);
+	m.spiinirq = avr_io_getirq(avr, AVR_IOCTL_SPI_GETIRQ(0), SPI_IRQ_INPUT);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), sckpin), hx711sim_sck, &m);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_SPI_GETIRQ(0), SPI_IRQ_OUTPUT), hx711sim_spi, &m);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), hx711sim_uart, &m);
+	avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+	flags &= ~AVR_UART_FLAG_STDIO;
+	avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+	//dout is high until the first conversion
+	avr_raise_irq(m.dtirq, 1);
+	avr_cycle_timer_register_usec(avr, HX711SIM_PERIODUS, hx711sim_convert, &m);
+
+	while(state != cpu_Done && state != cpu_Crashed) {
+		state = avr_run(avr);
+		if(avr->cycle > (avr_cycle_count_t)HX711SIM_TIMEOUTS*HX711SIM_FREQUENCY) {
+			printf("error: firmware timeout\n");
+			m.errors++;
+			break;
+		}
+	}
+	if(state == cpu_Crashed) {
+		printf("error: firmware crashed\n");
+		m.errors++;
+	}
+
+	hx711sim_check(&m);
+	printf("conversions %u, missed %u, errors %u\n", m.conversions, m.missed, m.errors);
+	printf("%s\n", m.errors ? "FAIL" : "PASS");
+
+	return m.errors ? 1 : 0;
+}
@@ -0,0 +1,39 @@
+/*
+hx711 simavr harness 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + test parameters shared by the harness and the test firmware
+*/
+
+
+#ifndef HX711SIM_H_
+#define HX711SIM_H_
+
+
+//conversion period of the model (us), 80 SPS
+#define HX711SIM_PERIODUS 12500
+
+//gain of the test, channel A gain 64 is 3 pulses after the 24 bits
+#define HX711SIM_GAIN 3
+
+//channel pattern of the test, one channel B slot of 8
+#define HX711SIM_PATTERN 0x80
+#define HX711SIM_PATTERNLEN 8
+
+//channel A reads polled like the main loop, then blocking reads
+#define HX711SIM_READS 32
+#define HX711SIM_READSCUT 16
+
+//settling conversions after a gain or channel switch, as HX711_SETTLEPERIODS
+#define HX711SIM_SETTLEPERIODS 4
+
+//uart bytes sent by the test firmware: the reads, channel B value, channel B
+//samples count and faults
+#define HX711SIM_UARTBYTES ((HX711SIM_READS+HX711SIM_READSCUT)*3 + 3 + 2 + 1)
+
+#endif
@@ -0,0 +1,75 @@
+/*
+hx711 simavr test firmware 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + reads the hx711 model through the hx711 lib, the board revision set at
+    build time selects the bit-bang or the spi transport
+  + every value is sent on the uart (38400 baud) msb first, the harness
+    checks them against the words shifted out by the model
+*/
+
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "../../src/hx711/hx711.h"
+#include "hx711sim.h"
+
+/**
+ * send the lower bytes of a value, msb first
+ */
+static void hx711test_send(uint32_t value, uint8_t bytes) {
+	while(bytes--) {
+		while(!(UCSRA & (1<<UDRE)));
+		UDR = (uint8_t)(value >> (8*bytes));
+	}
+}
+
+int main(void) {
+	uint8_t i = 0;
+
+	//uart tx, 38400 baud at 8MHz, 8n1
+	UBRRH = 0;
+	UBRRL = 12;
+	UCSRC = (1<<URSEL) | (1<<UCSZ1) | (1<<UCSZ0);
+	UCSRB = (1<<TXEN);
+
+#if HX711_SPIENABLED == 1
+	//ss as output keeps the spi in master mode
+	DDRB |= (1<<PB2);
+#endif
+
+	hx711_init(HX711SIM_GAIN, HX711_SCALEDEFAULT, HX711_OFFSETDEFAULT);
+	hx711_setrate(HX711_RATE80SPS);
+	//settle the gain, main does it with the boot period measure
+	for(i=0; i<HX711_SETTLEPERIODS; i++)
+		hx711_read();
+	hx711_setpattern(HX711SIM_PATTERN, HX711SIM_PATTERNLEN);
+
+	//poll like the main loop, the channel B bursts are read in background
+	for(i=0; i<HX711SIM_READS; i++) {
+		while(!hx711_isready());
+		hx711test_send(hx711_read(), 3);
+	}
+	//blocking reads, a channel B burst in progress is cut
+	for(i=0; i<HX711SIM_READSCUT; i++)
+		hx711test_send(hx711_read(), 3);
+
+	hx711test_send(hx711_getchannelb(), 3);
+	hx711test_send(hx711_getchannelbcount(), 2);
+	hx711test_send(hx711_getfault(), 1);
+
+	//the simulator stops on a sleep with interrupts off
+	while(!(UCSRA & (1<<TXC)));
+	cli();
+	sleep_enable();
+	sleep_cpu();
+
+	return 0;
+}
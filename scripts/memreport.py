@@ -0,0 +1,130 @@
+#
+# avr industrial weight checker t01 - memory report
+#
+# copyright (c) Davide Gironi, 2021
+#
+# Released under GPLv3.
+# Please refer to LICENSE file for licensing information.
+#
+# PlatformIO post build script, prints the .data/.bss sizes and a static
+# worst case stack estimate per call chain.
+# The estimate uses the gcc -fstack-usage output (see build_flags) and the call graph taken
+# from the disassembly, every call adds the 2 bytes return address,
+# interrupts add the return address and are not nested.
+#
+
+Import("env")
+
+import os
+import re
+import subprocess
+
+#ram size of the atmega8
+RAMSIZE = 1024
+
+
+def readsizes(sizetool, elf):
+    sizes = {}
+    out = subprocess.check_output([sizetool, "-A", elf]).decode()
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0].startswith(".") and fields[1].isdigit():
+            sizes[fields[0]] = int(fields[1])
+    return sizes
+
+
+def readstackusage(builddir):
+    frames = {}
+    for root, dirs, files in os.walk(builddir):
+        for name in files:
+            if not name.endswith(".su"):
+                continue
+            with open(os.path.join(root, name)) as f:
+                for line in f:
+                    fields = line.rstrip().split("\t")
+                    if len(fields) < 3:
+                        continue
+                    function = fields[0].split(":")[-1]
+                    frames[function] = (int(fields[1]), fields[2])
+    return frames
+
+
+def readcallgraph(objdump, elf):
+    calls = {}
+    indirect = set()
+    current = None
+    out = subprocess.check_output([objdump, "-d", elf]).decode()
+    for line in out.splitlines():
+        m = re.match(r"^[0-9a-f]+ <([^>]+)>:", line)
+        if m:
+            current = m.group(1)
+            calls.setdefault(current, set())
+            continue
+        if current is None:
+            continue
+        m = re.search(r"\t(r?call)\s.*<([^>+]+)(\+0x[0-9a-f]+)?>", line)
+        if m:
+            calls[current].add(m.group(2))
+        elif re.search(r"\t(e?icall)\b", line):
+            indirect.add(current)
+    return calls, indirect
+
+
+def worstchain(function, calls, frames, visiting):
+    if function in visiting:
+        return 0, [function + " (recursion)"]
+    visiting.add(function)
+    own = frames.get(function, (0, "static"))[0]
+    best = 0
+    bestchain = []
+    for callee in calls.get(function, ()):
+        depth, chain = worstchain(callee, calls, frames, visiting)
+        depth += 2
+        if depth > best:
+            best = depth
+            bestchain = chain
+    visiting.discard(function)
+    return own + best, [function] + bestchain
+
+
+def memreport(source, target, env):
+    elf = str(target[0])
+    builddir = env.subst("$BUILD_DIR")
+    sizetool = env.subst("$SIZETOOL") or "avr-size"
+    objdump = env.subst("$CC").replace("gcc", "objdump")
+
+    sizes = readsizes(sizetool, elf)
+    frames = readstackusage(builddir)
+    calls, indirect = readcallgraph(objdump, elf)
+
+    data = sizes.get(".data", 0)
+    bss = sizes.get(".bss", 0)
+    noinit = sizes.get(".noinit", 0)
+    static = data + bss + noinit
+
+    print("Memory report")
+    print("  .data    %5d bytes" % data)
+    print("  .bss     %5d bytes" % bss)
+    print("  .noinit  %5d bytes" % noinit)
+    print("  stack    %5d bytes available" % (RAMSIZE - static))
+
+    roots = ["main"] + sorted(f for f in calls if f.startswith("__vector_"))
+    mainworst = 0
+    isrworst = 0
+    for root in roots:
+        if root not in calls:
+            continue
+        depth, chain = worstchain(root, calls, frames, set())
+        print("  %-12s %5d bytes: %s" % (root, depth, " -> ".join(chain)))
+        if root == "main":
+            mainworst = depth
+        else:
+            isrworst = max(isrworst, depth + 2)
+    for function in sorted(f for f in frames if frames[f][1] != "static"):
+        print("  warning: %s has a %s frame" % (function, frames[function][1]))
+    for function in sorted(indirect):
+        print("  warning: %s does indirect calls, not followed" % function)
+    print("  worst case stack %d bytes, free %d bytes" % (mainworst + isrworst, RAMSIZE - static - mainworst - isrworst))
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", memreport)
@@ -0,0 +1,118 @@
+/*
+board definitions 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + the ports and pins of every board revision are set here, the hx711,
+    lcd and key libraries and main include this file
+  + a line is set by its port and pin number, the ddr and pin registers
+    are derived from the port address
+  + pins are constants, the drivers test the wiring with constant
+    expressions folded by the compiler, lcd data lines on contiguous pins
+    of one port are written with a single port operation
+*/
+
+#include <avr/io.h>
+
+
+#ifndef BOARD_H_
+#define BOARD_H_
+
+
+//board revisions
+#define BOARD_REV1 1 //t01 v1.0, hx711 bit-bang on PB0/PB1, rate pin hard-wired
+#define BOARD_REV2 2 //hx711 on the spi PB4/PB5, rate pin on PB3
+
+//selected board revision, a build can override it
+#ifndef BOARD_REV
+#define BOARD_REV BOARD_REV1
+#endif
+
+//ddr and pin registers of a port
+#define BOARD_DDR(port) (*(&(port) - 1))
+#define BOARD_PIN(port) (*(&(port) - 2))
+
+//hx711
+#if BOARD_REV == BOARD_REV1
+#define HX711_SPIENABLED 0
+#define HX711_RATEPINENABLED 0
+#define HX711_DTPORT PORTB
+#define HX711_DTPINNUM PB0
+#define HX711_SCKPORT PORTB
+#define HX711_SCKPINNUM PB1
+#elif BOARD_REV == BOARD_REV2
+#define HX711_SPIENABLED 1
+#define HX711_RATEPINENABLED 1
+#define HX711_DTPORT PORTB
+#define HX711_DTPINNUM PB4
+#define HX711_SCKPORT PORTB
+#define HX711_SCKPINNUM PB5
+#else
+#error "unknown board revision"
+#endif
+#define HX711_DTDDR BOARD_DDR(HX711_DTPORT)
+#define HX711_DTPIN BOARD_PIN(HX711_DTPORT)
+#define HX711_SCKDDR BOARD_DDR(HX711_SCKPORT)
+#define HX711_RATEPORT PORTB
+#define HX711_RATEPINNUM PB3
+#define HX711_RATEDDR BOARD_DDR(HX711_RATEPORT)
+
+//lcd, 4 bit io mode
+#define LCD_DATA0_PORT PORTD
+#define LCD_DATA1_PORT PORTD
+#define LCD_DATA2_PORT PORTD
+#define LCD_DATA3_PORT PORTD
+#define LCD_DATA0_PIN 4
+#define LCD_DATA1_PIN 5
+#define LCD_DATA2_PIN 6
+#define LCD_DATA3_PIN 7
+#define LCD_RS_PORT PORTC
+#define LCD_RS_PIN 5
+#define LCD_RW_PORT PORTC
+#define LCD_RW_PIN 4
+#define LCD_E_PORT PORTC
+#define LCD_E_PIN 3
+
+//keys, use pullup resistors
+#define KEY_PORT PORTC
+#define KEY_DDR BOARD_DDR(KEY_PORT)
+#define KEY_PIN BOARD_PIN(KEY_PORT)
+#define KEY_BUTTON1 PC0
+#define KEY_BUTTON2 PC1
+#define KEY_BUTTON3 PC2
+
+//checkweigher trigger, photo-eye on INT0, active low, falling edge
+#define CHECKWEIGHER_TRIGGERPORT PORTD
+#define CHECKWEIGHER_TRIGGERDDR BOARD_DDR(CHECKWEIGHER_TRIGGERPORT)
+#define CHECKWEIGHER_TRIGGERPINNUM PD2
+#define CHECKWEIGHER_TRIGGERINTERRUPT ISR(INT0_vect)
+#define CHECKWEIGHER_TRIGGERINIT \
+	MCUCR |= (1<<ISC01); \
+	GICR |= (1<<INT0);
+
+//alarm relay, active low
+#define RELALERT_PORT PORTB
+#define RELALERT_DDR BOARD_DDR(RELALERT_PORT)
+#define RELALERT_PINNUM PB2
+#define RELALERT_OFF RELALERT_PORT |= (1<<RELALERT_PINNUM)
+#define RELALERT_ON RELALERT_PORT &= ~(1<<RELALERT_PINNUM)
+
+//skip relay, active low
+#define RELSKIP_PORT PORTD
+#define RELSKIP_DDR BOARD_DDR(RELSKIP_PORT)
+#define RELSKIP_PINNUM PD3
+#define RELSKIP_OFF RELSKIP_PORT |= (1<<RELSKIP_PINNUM)
+#define RELSKIP_ON RELSKIP_PORT &= ~(1<<RELSKIP_PINNUM)
+
+//recipe select input, active low, first pin of RECIPE_INPUTMASK
+#define RECIPE_INPUTPORT PORTB
+#define RECIPE_INPUTDDR BOARD_DDR(RECIPE_INPUTPORT)
+#define RECIPE_INPUTPIN BOARD_PIN(RECIPE_INPUTPORT)
+#define RECIPE_INPUTPINNUM PB6 //pins are PB6 and PB7
+#define RECIPE_INPUTMASK 0x03
+
+#endif
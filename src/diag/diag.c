@@ -0,0 +1,213 @@
+/*
+diag lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+*/
+
+
+#include "diag.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#if DIAG_ENABLED == 1
+
+//linker symbols
+extern uint8_t __data_start;
+extern uint8_t __data_end;
+extern uint8_t __bss_start;
+extern uint8_t __bss_end;
+extern uint8_t _end;
+extern uint8_t __stack;
+
+//cycle counter high word
+static volatile uint16_t diag_cycleshigh = 0;
+
+//collected data
+static diag_t diag_data;
+
+//loop average accumulator, scaled by 2^DIAG_LOOPAVGSHIFT
+static uint32_t diag_loopavgacc = 0;
+
+/**
+ * paint the free ram before the stack pointer and the registers are set up
+ */
+void diag_stackpaint(void) __attribute__ ((naked)) __attribute__ ((used)) __attribute__ ((section (".init1")));
+void diag_stackpaint(void) {
+	__asm volatile (
+		"    ldi r30,lo8(_end)\n"
+		"    ldi r31,hi8(_end)\n"
+		"    ldi r24,%0\n"
+		"    ldi r25,hi8(__stack)\n"
+		"    rjmp 2f\n"
+		"1:\n"
+		"    st Z+,r24\n"
+		"2:\n"
+		"    cpi r30,lo8(__stack)\n"
+		"    cpc r31,r25\n"
+		"    brlo 1b\n"
+		"    breq 1b\n"
+		:: "M" (DIAG_STACKCANARY));
+}
+
+/**
+ * cycle counter overflow interrupt
+ */
+ISR(TIMER1_OVF_vect) {
+	diag_cycleshigh++;
+}
+
+/**
+ * get the 32 bits cycle counter
+ */
+uint32_t diag_getcycles() {
+	uint16_t high = 0;
+	uint16_t low = 0;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		high = diag_cycleshigh;
+		low = TCNT1;
+		//overflow pending but not yet served
+		if((TIFR & (1<<TOV1)) && low < 0x8000)
+			high++;
+	}
+	return ((uint32_t)high<<16) | low;
+}
+
+/**
+ * mark a main loop iteration, compute max and average iteration time
+ */
+void diag_loopmark() {
+	static uint32_t last = 0;
+	uint32_t now = diag_getcycles();
+
+	if(last != 0) {
+		uint32_t elapsed = now - last;
+		if(elapsed > diag_data.loopmax)
+			diag_data.loopmax = elapsed;
+		diag_loopavgacc += elapsed - (diag_loopavgacc>>DIAG_LOOPAVGSHIFT);
+		diag_data.loopavg = diag_loopavgacc>>DIAG_LOOPAVGSHIFT;
+	}
+	last = now;
+}
+
+/**
+ * set the time blocked in the hx711 read
+ */
+void diag_sethx711(uint32_t cycles) {
+	if(cycles > diag_data.hx711max)
+		diag_data.hx711max = cycles;
+}
+
+/**
+ * set the time spent refreshing the lcd
+ */
+void diag_setlcd(uint32_t cycles) {
+	diag_data.lcdlast = cycles;
+	if(cycles > diag_data.lcdmax)
+		diag_data.lcdmax = cycles;
+}
+
+/**
+ * set the interrupt duration, called by the interrupt
+ */
+void diag_setisr(uint16_t cycles) {
+	if(cycles > diag_data.isrmax)
+		diag_data.isrmax = cycles;
+}
+
+/**
+ * count a dropped sample, called by the interrupt
+ */
+void diag_sampledropped() {
+	diag_data.samplesdropped++;
+}
+
+/**
+ * get a copy of the collected data
+ */
+void diag_get(diag_t *d) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		memcpy(d, &diag_data, sizeof(diag_t));
+	}
+}
+
+/**
+ * get the watchdog margin in cycles, the worst loop iteration is the longest wdt_reset gap
+ */
+uint32_t diag_getwdtmargin() {
+	uint32_t loopmax = 0;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		loopmax = diag_data.loopmax;
+	}
+	if(loopmax >= DIAG_WDTCYCLES)
+		return 0;
+	return DIAG_WDTCYCLES - loopmax;
+}
+
+/**
+ * get the .data size
+ */
+uint16_t diag_getdatasize() {
+	return &__data_end - &__data_start;
+}
+
+/**
+ * get the .bss size
+ */
+uint16_t diag_getbsssize() {
+	return &__bss_end - &__bss_start;
+}
+
+/**
+ * get the ram available to the stack
+ */
+uint16_t diag_getstacksize() {
+	return &__stack - &_end + 1;
+}
+
+/**
+ * get the stack never used since startup, the stack high water mark is size minus free
+ */
+uint16_t diag_getstackfree() {
+	const uint8_t *p = &_end;
+	uint16_t count = 0;
+	while(p <= &__stack && *p == DIAG_STACKCANARY) {
+		p++;
+		count++;
+	}
+	return count;
+}
+
+/**
+ * reset collected data
+ */
+void diag_reset() {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		memset(&diag_data, 0, sizeof(diag_t));
+		diag_loopavgacc = 0;
+	}
+}
+
+/**
+ * initialize the cycle counter
+ */
+void diag_init() {
+	//normal mode, no prescaler
+	TCCR1A = 0;
+	TCCR1B = (1<<CS10);
+	TCNT1 = 0;
+	//enable overflow interrupt
+	TIMSK |= (1<<TOIE1);
+}
+
+#endif
@@ -0,0 +1,88 @@
+/*
+diag lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + uses Timer1 as a free running cycle counter (prescaler 1),
+    the counter is extended to 32 bits by the overflow interrupt
+  + the free ram is painted at startup (.init1), the stack high water
+    mark is the painted area that has been overwritten
+  + when DIAG_ENABLED is 0 every macro expands to nothing
+*/
+
+#include <avr/io.h>
+
+
+#ifndef DIAG_H_
+#define DIAG_H_
+
+
+//enable diagnostics
+#define DIAG_ENABLED 0
+
+//watchdog timeout in cycles, used to compute the watchdog margin
+#define DIAG_WDTCYCLES F_CPU
+
+//loop average filter shift, average over 2^n iterations
+#define DIAG_LOOPAVGSHIFT 4
+
+//stack paint pattern
+#define DIAG_STACKCANARY 0xC5
+
+//cycles to microseconds
+#define DIAG_CYCLES2US(c) ((c)/(F_CPU/1000000UL))
+
+//diagnostics data
+typedef struct {
+	uint32_t loopmax;
+	uint32_t loopavg;
+	uint32_t hx711max;
+	uint32_t lcdlast;
+	uint32_t lcdmax;
+	uint16_t isrmax;
+	uint16_t samplesdropped;
+} diag_t;
+
+#if DIAG_ENABLED == 1
+//time a block of code
+#define DIAG_START(t) uint32_t t = diag_getcycles();
+#define DIAG_STOPHX711(t) diag_sethx711(diag_getcycles() - t);
+#define DIAG_STOPLCD(t) diag_setlcd(diag_getcycles() - t);
+//time the interrupt, the isr never lasts more than a Timer1 period
+#define DIAG_ISRSTART(t) uint16_t t = TCNT1;
+#define DIAG_ISRSTOP(t) diag_setisr(TCNT1 - t);
+//mark a main loop iteration
+#define DIAG_LOOPMARK diag_loopmark();
+//count a dropped sample
+#define DIAG_SAMPLEDROPPED diag_sampledropped();
+#else
+#define DIAG_START(t)
+#define DIAG_STOPHX711(t)
+#define DIAG_STOPLCD(t)
+#define DIAG_ISRSTART(t)
+#define DIAG_ISRSTOP(t)
+#define DIAG_LOOPMARK
+#define DIAG_SAMPLEDROPPED
+#endif
+
+//functions
+extern uint32_t diag_getcycles();
+extern void diag_loopmark();
+extern void diag_sethx711(uint32_t cycles);
+extern void diag_setlcd(uint32_t cycles);
+extern void diag_setisr(uint16_t cycles);
+extern void diag_sampledropped();
+extern void diag_get(diag_t *d);
+extern uint32_t diag_getwdtmargin();
+extern uint16_t diag_getdatasize();
+extern uint16_t diag_getbsssize();
+extern uint16_t diag_getstacksize();
+extern uint16_t diag_getstackfree();
+extern void diag_reset();
+extern void diag_init();
+
+#endif
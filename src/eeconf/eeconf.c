@@ -0,0 +1,246 @@
+/*
+eeconf lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+*/
+
+
+#include "eeconf.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+
+
+#if EECONF_EEEND(EECONF_CONFEEADDR, EECONF_CONFSLOTS, EECONF_CONFDATASIZE) > EECONF_CALEEADDR || \
+		EECONF_EEEND(EECONF_CALEEADDR, EECONF_CALSLOTS, EECONF_CALDATASIZE) > EECONF_CWEEADDR || \
+		EECONF_EEEND(EECONF_CWEEADDR, EECONF_CWSLOTS, EECONF_CWDATASIZE) > EECONF_FLOWEEADDR || \
+		EECONF_EEEND(EECONF_FLOWEEADDR, EECONF_FLOWSLOTS, EECONF_FLOWDATASIZE) > EECONF_STATSEEADDR
+#error "eeconf journals overlap"
+#endif
+#if EECONF_EEADDREND > E2END+1
+#error "eeconf journals exceed the eeprom size"
+#endif
+#if EECONF_EEEND(EECONF_KFEEADDR, EECONF_KFSLOTS, EECONF_KFDATASIZE) > EECONF_CONFEEADDR
+#error "eeconf kalman filter journal exceeds the gap below the configuration journal"
+#endif
+#if EECONF_CONFDATASIZE > EECONF_DATASIZEMAX || EECONF_CALDATASIZE > EECONF_DATASIZEMAX || EECONF_CWDATASIZE > EECONF_DATASIZEMAX || \
+		EECONF_FLOWDATASIZE > EECONF_DATASIZEMAX || EECONF_STATSDATASIZE > EECONF_DATASIZEMAX || EECONF_KFDATASIZE > EECONF_DATASIZEMAX
+#error "eeconf journal data size exceeds the record buffer"
+#endif
+
+//record fields offset
+#define EECONF_SEQ 0
+#define EECONF_LEN 1
+#define EECONF_DATA 2
+
+//journals region
+typedef struct {
+	uint16_t eeaddr;
+	uint8_t slots;
+	uint8_t datasize;
+} eeconf_journalt;
+static const eeconf_journalt eeconf_journals[EECONF_JOURNALS] PROGMEM = {
+	{ EECONF_CONFEEADDR, EECONF_CONFSLOTS, EECONF_CONFDATASIZE },
+	{ EECONF_CALEEADDR, EECONF_CALSLOTS, EECONF_CALDATASIZE },
+	{ EECONF_CWEEADDR, EECONF_CWSLOTS, EECONF_CWDATASIZE },
+	{ EECONF_FLOWEEADDR, EECONF_FLOWSLOTS, EECONF_FLOWDATASIZE },
+	{ EECONF_STATSEEADDR, EECONF_STATSSLOTS, EECONF_STATSDATASIZE },
+	{ EECONF_KFEEADDR, EECONF_KFSLOTS, EECONF_KFDATASIZE }
+};
+
+//slot of the newest record, 0xFF if none
+static uint8_t eeconf_slot[EECONF_JOURNALS] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+//sequence of the newest record
+static uint8_t eeconf_seq[EECONF_JOURNALS];
+
+//record being written
+static uint8_t eeconf_buf[EECONF_SLOTSIZE(EECONF_DATASIZEMAX)];
+static volatile uint8_t eeconf_bufindex = 0;
+static uint8_t eeconf_buflen = 0;
+static uint16_t eeconf_bufaddr = 0;
+static volatile uint8_t eeconf_busy = 0;
+
+/**
+ * get the address of a slot
+ */
+static uint16_t eeconf_slotaddr(const eeconf_journalt *j, uint8_t slot) {
+	return j->eeaddr + (uint16_t)slot*EECONF_SLOTSIZE(j->datasize);
+}
+
+/**
+ * check the crc of a slot, return the data length or 0 if not valid
+ */
+static uint8_t eeconf_checkslot(const eeconf_journalt *j, uint8_t slot) {
+	uint16_t addr = eeconf_slotaddr(j, slot);
+	uint8_t len = eeprom_read_byte((const uint8_t *)(addr + EECONF_LEN));
+	uint16_t crc = 0xFFFF;
+	uint8_t i = 0;
+
+	if(len == 0 || len > j->datasize)
+		return 0;
+	for(i=0; i<len+EECONF_DATA; i++)
+		crc = _crc16_update(crc, eeprom_read_byte((const uint8_t *)(addr + i)));
+	if(crc != eeprom_read_word((const uint16_t *)(addr + EECONF_DATA + len)))
+		return 0;
+	return len;
+}
+
+/**
+ * eeprom ready interrupt, write the next byte that differs
+ */
+ISR(EE_RDY_vect) {
+	while(eeconf_bufindex < eeconf_buflen) {
+		uint8_t data = eeconf_buf[eeconf_bufindex];
+		EEAR = eeconf_bufaddr + eeconf_bufindex;
+		eeconf_bufindex++;
+		EECR |= (1<<EERE);
+		if(EEDR != data) {
+			EEDR = data;
+			EECR |= (1<<EEMWE);
+			EECR |= (1<<EEWE);
+			return;
+		}
+	}
+
+	//record written
+	EECR &= ~(1<<EERIE);
+	eeconf_busy = 0;
+}
+
+/**
+ * load the newest valid record, return the data length or 0 if there are no valid records,
+ * waits for a background write to end
+ */
+uint8_t eeconf_read(uint8_t journal, void *data, uint8_t size) {
+	eeconf_journalt j;
+	uint8_t slot = 0;
+	uint8_t len = 0;
+	uint8_t newestlen = 0;
+
+	memcpy_P(&j, &eeconf_journals[journal], sizeof(eeconf_journalt));
+
+	//the eeprom address can not be changed during a write
+	while(eeconf_busy);
+
+	eeconf_slot[journal] = 0xFF;
+	for(slot=0; slot<j.slots; slot++) {
+		uint8_t seq = eeprom_read_byte((const uint8_t *)eeconf_slotaddr(&j, slot));
+		//skip older records
+		if(eeconf_slot[journal] != 0xFF && (int8_t)(seq - eeconf_seq[journal]) <= 0)
+			continue;
+		len = eeconf_checkslot(&j, slot);
+		if(len) {
+			eeconf_slot[journal] = slot;
+			eeconf_seq[journal] = seq;
+			newestlen = len;
+		}
+	}
+
+	if(eeconf_slot[journal] == 0xFF)
+		return 0;
+
+	if(newestlen > size)
+		newestlen = size;
+	eeprom_read_block(data, (const void *)(eeconf_slotaddr(&j, eeconf_slot[journal]) + EECONF_DATA), newestlen);
+	return newestlen;
+}
+
+/**
+ * append a record, the write is done in background
+ */
+uint8_t eeconf_write(uint8_t journal, const void *data, uint8_t size) {
+	eeconf_journalt j;
+	uint16_t crc = 0xFFFF;
+	uint8_t slot = 0;
+	uint8_t i = 0;
+
+	if(eeconf_busy)
+		return EECONF_WRITEBUSY;
+
+	memcpy_P(&j, &eeconf_journals[journal], sizeof(eeconf_journalt));
+
+	if(size > j.datasize)
+		size = j.datasize;
+
+	//skip if data is the same of the newest record
+	if(eeconf_slot[journal] != 0xFF) {
+		uint16_t addr = eeconf_slotaddr(&j, eeconf_slot[journal]);
+		if(eeprom_read_byte((const uint8_t *)(addr + EECONF_LEN)) == size) {
+			for(i=0; i<size; i++) {
+				if(eeprom_read_byte((const uint8_t *)(addr + EECONF_DATA + i)) != ((const uint8_t *)data)[i])
+					break;
+			}
+			if(i == size)
+				return EECONF_WRITEUNCHANGED;
+		}
+	}
+
+	//build the record
+	slot = eeconf_slot[journal] + 1;
+	if(slot >= j.slots)
+		slot = 0;
+	eeconf_buf[EECONF_SEQ] = eeconf_seq[journal] + 1;
+	eeconf_buf[EECONF_LEN] = size;
+	memcpy(&eeconf_buf[EECONF_DATA], data, size);
+	for(i=0; i<size+EECONF_DATA; i++)
+		crc = _crc16_update(crc, eeconf_buf[i]);
+	eeconf_buf[EECONF_DATA + size] = (uint8_t)crc;
+	eeconf_buf[EECONF_DATA + size + 1] = (uint8_t)(crc>>8);
+
+	//start the background write
+	eeconf_slot[journal] = slot;
+	eeconf_seq[journal]++;
+	eeconf_bufaddr = eeconf_slotaddr(&j, slot);
+	eeconf_buflen = size + EECONF_DATA + 2;
+	eeconf_bufindex = 0;
+	eeconf_busy = 1;
+	EECR |= (1<<EERIE);
+
+	return EECONF_WRITESTARTED;
+}
+
+/**
+ * write a block outside the journals, the write is done in background
+ */
+uint8_t eeconf_writeblock(uint16_t addr, const void *data, uint8_t size) {
+	if(eeconf_busy)
+		return EECONF_WRITEBUSY;
+
+	if(size > sizeof(eeconf_buf))
+		size = sizeof(eeconf_buf);
+	memcpy(eeconf_buf, data, size);
+
+	//start the background write
+	eeconf_bufaddr = addr;
+	eeconf_buflen = size;
+	eeconf_bufindex = 0;
+	eeconf_busy = 1;
+	EECR |= (1<<EERIE);
+
+	return EECONF_WRITESTARTED;
+}
+
+/**
+ * read a block outside the journals, return 0 if a background write is running
+ */
+uint8_t eeconf_readblock(uint16_t addr, void *data, uint8_t size) {
+	if(eeconf_busy)
+		return 0;
+	eeprom_read_block(data, (const void *)addr, size);
+	return 1;
+}
+
+/**
+ * check if a background write is running
+ */
+uint8_t eeconf_isbusy() {
+	return eeconf_busy;
+}
@@ -0,0 +1,103 @@
+/*
+eeconf lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + configuration records are appended to a rotating eeprom region,
+    a record is: sequence (1 byte), length (1 byte), data, crc16 (2 bytes)
+  + at boot the valid record with the newest sequence is loaded, a record
+    broken by a reset during the write is discarded by the crc
+  + a write is skipped if data does not differ from the newest record,
+    otherwise the next slot is written in background, one byte for each
+    eeprom ready interrupt, bytes already equal are not written
+  + every journal has its own region, one write at a time is performed
+  + a record longer than the journal data size is truncated, the callers
+    check their structures against the data sizes at build time
+  + a journal with one slot is rewritten in place, a reset during the
+    write loses the record
+  + blocks outside the journals can be written in background and read
+    through the same interrupt, so that they never collide with a record
+  + journal addresses are fixed, a journal never moves when another one
+    is added, new journals are appended
+  + the configuration journal has 2 slots, a record is written only when
+    the configuration changes, so every journal and the event log fit
+    the eeprom
+  + the kalman filter journal is in the gap between the legacy block and
+    the configuration journal
+*/
+
+#include <avr/io.h>
+
+
+#ifndef EECONF_H_
+#define EECONF_H_
+
+
+//journals
+#define EECONF_JOURNALS 6
+
+//record size
+#define EECONF_SLOTSIZE(datasize) ((datasize)+4)
+
+//journal region end
+#define EECONF_EEEND(eeaddr, slots, datasize) ((eeaddr)+(slots)*EECONF_SLOTSIZE(datasize))
+
+//configuration journal
+#define EECONF_CONF 0
+#define EECONF_CONFEEADDR 32
+#define EECONF_CONFSLOTS 2
+#define EECONF_CONFDATASIZE 56
+
+//calibration journal
+#define EECONF_CAL 1
+#define EECONF_CALEEADDR 152
+#define EECONF_CALSLOTS 2
+#define EECONF_CALDATASIZE 49
+
+//checkweigher journal
+#define EECONF_CW 2
+#define EECONF_CWEEADDR 258
+#define EECONF_CWSLOTS 2
+#define EECONF_CWDATASIZE 25
+
+//flow rate journal
+#define EECONF_FLOW 3
+#define EECONF_FLOWEEADDR 316
+#define EECONF_FLOWSLOTS 2
+#define EECONF_FLOWDATASIZE 7
+
+//production statistics snapshot journal, written on request only
+#define EECONF_STATS 4
+#define EECONF_STATSEEADDR 338
+#define EECONF_STATSSLOTS 1
+#define EECONF_STATSDATASIZE 47
+
+//end of the journals
+#define EECONF_EEADDREND EECONF_EEEND(EECONF_STATSEEADDR, EECONF_STATSSLOTS, EECONF_STATSDATASIZE)
+
+//kalman filter journal, below the configuration journal, after the legacy block
+#define EECONF_KF 5
+#define EECONF_KFEEADDR 24
+#define EECONF_KFSLOTS 1
+#define EECONF_KFDATASIZE 4
+
+//max data size of journals
+#define EECONF_DATASIZEMAX 56
+
+//write return codes
+#define EECONF_WRITEBUSY 0
+#define EECONF_WRITESTARTED 1
+#define EECONF_WRITEUNCHANGED 2
+
+//functions
+extern uint8_t eeconf_read(uint8_t journal, void *data, uint8_t size);
+extern uint8_t eeconf_write(uint8_t journal, const void *data, uint8_t size);
+extern uint8_t eeconf_writeblock(uint16_t addr, const void *data, uint8_t size);
+extern uint8_t eeconf_readblock(uint16_t addr, void *data, uint8_t size);
+extern uint8_t eeconf_isbusy();
+
+#endif
@@ -0,0 +1,155 @@
+/*
+eventlog lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+*/
+
+
+#include "eventlog.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+
+
+#if EVENTLOG_EEADDREND > E2END+1
+#error "the event log exceeds the eeprom size"
+#endif
+#if EVENTLOG_RECORDS > 15
+#error "the 4 bits sequence needs less than 16 records"
+#endif
+
+//record fields offset
+#define EVENTLOG_ERRORS 0
+#define EVENTLOG_DIFF 1
+#define EVENTLOG_TIME 3
+#define EVENTLOG_RAW 6
+#define EVENTLOG_TYPESEQ 9
+
+//type and sequence
+#define EVENTLOG_TYPE(typeseq) ((typeseq) & 0x0F)
+#define EVENTLOG_SEQ(typeseq) ((typeseq) >> 4)
+
+//newest record, sequence and number of records
+static uint8_t eventlog_head = EVENTLOG_RECORDS-1;
+static uint8_t eventlog_seq = 0x0F;
+static uint8_t eventlog_count = 0;
+
+//records waiting to be written
+static uint8_t eventlog_queue[EVENTLOG_QUEUESIZE][EVENTLOG_RECORDSIZE];
+static uint8_t eventlog_queuehead = 0;
+static uint8_t eventlog_queuecount = 0;
+
+/**
+ * get the address of a record
+ */
+static uint16_t eventlog_recordaddr(uint8_t record) {
+	return EVENTLOG_EEADDR + (uint16_t)record*EVENTLOG_RECORDSIZE;
+}
+
+/**
+ * find the newest record, waits for an eeconf background write to end
+ */
+void eventlog_init() {
+	uint8_t i = 0;
+
+	while(eeconf_isbusy());
+
+	eventlog_head = EVENTLOG_RECORDS-1;
+	eventlog_seq = 0x0F;
+	eventlog_count = 0;
+	for(i=0; i<EVENTLOG_RECORDS; i++) {
+		uint8_t typeseq = eeprom_read_byte((const uint8_t *)(eventlog_recordaddr(i) + EVENTLOG_TYPESEQ));
+		uint8_t next = eeprom_read_byte((const uint8_t *)(eventlog_recordaddr((i + 1) % EVENTLOG_RECORDS) + EVENTLOG_TYPESEQ));
+		if(EVENTLOG_TYPE(typeseq) == EVENTLOG_TYPENONE)
+			continue;
+		eventlog_count++;
+		if(EVENTLOG_TYPE(next) == EVENTLOG_TYPENONE || EVENTLOG_SEQ(next) != ((EVENTLOG_SEQ(typeseq) + 1) & 0x0F)) {
+			eventlog_head = i;
+			eventlog_seq = EVENTLOG_SEQ(typeseq);
+		}
+	}
+}
+
+/**
+ * queue an event, return 0 if the queue is full
+ */
+uint8_t eventlog_add(const eventlog_eventt *e) {
+	uint8_t *r = 0;
+
+	if(eventlog_queuecount == EVENTLOG_QUEUESIZE)
+		return 0;
+
+	r = eventlog_queue[(eventlog_queuehead + eventlog_queuecount) % EVENTLOG_QUEUESIZE];
+	r[EVENTLOG_ERRORS] = e->errors;
+	r[EVENTLOG_DIFF] = (uint8_t)e->diff;
+	r[EVENTLOG_DIFF+1] = (uint8_t)(e->diff>>8);
+	r[EVENTLOG_TIME] = (uint8_t)e->time;
+	r[EVENTLOG_TIME+1] = (uint8_t)(e->time>>8);
+	r[EVENTLOG_TIME+2] = (uint8_t)(e->time>>16);
+	r[EVENTLOG_RAW] = (uint8_t)e->raw;
+	r[EVENTLOG_RAW+1] = (uint8_t)(e->raw>>8);
+	r[EVENTLOG_RAW+2] = (uint8_t)(e->raw>>16);
+	r[EVENTLOG_TYPESEQ] = e->type & 0x0F; //sequence set on write
+	eventlog_queuecount++;
+	return 1;
+}
+
+/**
+ * write the queued events in background
+ */
+void eventlog_process() {
+	uint8_t *r = 0;
+	uint8_t record = 0;
+	uint8_t seq = 0;
+
+	if(eventlog_queuecount == 0)
+		return;
+
+	r = eventlog_queue[eventlog_queuehead];
+	record = (eventlog_head + 1) % EVENTLOG_RECORDS;
+	seq = (eventlog_seq + 1) & 0x0F;
+	r[EVENTLOG_TYPESEQ] = (r[EVENTLOG_TYPESEQ] & 0x0F) | (seq<<4);
+	if(eeconf_writeblock(eventlog_recordaddr(record), r, EVENTLOG_RECORDSIZE) != EECONF_WRITESTARTED)
+		return;
+
+	eventlog_head = record;
+	eventlog_seq = seq;
+	if(eventlog_count < EVENTLOG_RECORDS)
+		eventlog_count++;
+	eventlog_queuehead = (eventlog_queuehead + 1) % EVENTLOG_QUEUESIZE;
+	eventlog_queuecount--;
+}
+
+/**
+ * get the number of events in the log
+ */
+uint8_t eventlog_getcount() {
+	return eventlog_count;
+}
+
+/**
+ * get an event, 0 is the newest, return 0 if not available or a background write is running
+ */
+uint8_t eventlog_get(uint8_t index, eventlog_eventt *e) {
+	uint8_t r[EVENTLOG_RECORDSIZE];
+
+	if(index >= eventlog_count)
+		return 0;
+	if(!eeconf_readblock(eventlog_recordaddr((eventlog_head + EVENTLOG_RECORDS - index) % EVENTLOG_RECORDS), r, EVENTLOG_RECORDSIZE))
+		return 0;
+
+	e->type = EVENTLOG_TYPE(r[EVENTLOG_TYPESEQ]);
+	e->errors = r[EVENTLOG_ERRORS];
+	e->diff = (int16_t)(r[EVENTLOG_DIFF] | ((uint16_t)r[EVENTLOG_DIFF+1]<<8));
+	e->time = r[EVENTLOG_TIME] | ((uint32_t)r[EVENTLOG_TIME+1]<<8) | ((uint32_t)r[EVENTLOG_TIME+2]<<16);
+	e->raw = r[EVENTLOG_RAW] | ((uint32_t)r[EVENTLOG_RAW+1]<<8) | ((uint32_t)r[EVENTLOG_RAW+2]<<16);
+	//sign extend 24 bits
+	if(e->raw & 0x800000)
+		e->raw |= 0xFF000000;
+	return 1;
+}
@@ -0,0 +1,64 @@
+/*
+eventlog lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + events are written to a ring of records in the eeprom after the eeconf
+    journals, every write goes to the next record so wear is spread
+  + a record is: errors (1 byte), diff (2 bytes), time (3 bytes), raw
+    (3 bytes), type and sequence (1 byte), the type and sequence byte is
+    written last, at startup the newest record is the one not followed by
+    the next sequence
+  + events are queued in ram and written in background by the eeconf
+    interrupt, eventlog_process() must be called in the main loop
+*/
+
+#include <avr/io.h>
+
+#include "../eeconf/eeconf.h"
+
+
+#ifndef EVENTLOG_H_
+#define EVENTLOG_H_
+
+
+//records
+#define EVENTLOG_RECORDSIZE 10
+#define EVENTLOG_RECORDS 12
+
+//eeprom region, fixed
+#define EVENTLOG_EEADDR EECONF_EEADDREND
+#define EVENTLOG_EEADDREND (EVENTLOG_EEADDR + EVENTLOG_RECORDS*EVENTLOG_RECORDSIZE)
+
+//events waiting to be written
+#define EVENTLOG_QUEUESIZE 4
+
+//event types
+#define EVENTLOG_TYPERESET 0
+#define EVENTLOG_TYPEALARM 1
+#define EVENTLOG_TYPEALARMCLEAR 2
+#define EVENTLOG_TYPESKIP 3
+#define EVENTLOG_TYPEFAULT 4
+#define EVENTLOG_TYPENONE 0x0F
+
+//event
+typedef struct {
+	uint8_t type;
+	uint32_t time; //seconds, 24 bits
+	int32_t raw; //24 bits
+	int16_t diff;
+	uint8_t errors;
+} eventlog_eventt;
+
+//functions
+extern void eventlog_init();
+extern uint8_t eventlog_add(const eventlog_eventt *e);
+extern void eventlog_process();
+extern uint8_t eventlog_getcount();
+extern uint8_t eventlog_get(uint8_t index, eventlog_eventt *e);
+
+#endif
@@ -0,0 +1,119 @@
+/*
+flow lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+*/
+
+
+#include "flow.h"
+
+#include <stdio.h>
+#include <avr/io.h>
+
+
+//window weights, the oldest at head has index 0
+static int32_t flow_weights[FLOW_WINDOW];
+static uint8_t flow_head = 0;
+static uint8_t flow_count = 0;
+
+//sum of weights and sum of index times weight
+static int64_t flow_sy = 0;
+static int64_t flow_siy = 0;
+
+//totalizer
+static int32_t flow_last = 0;
+static int64_t flow_total = 0;
+
+/**
+ * restart the regression window
+ */
+void flow_restart() {
+	flow_head = 0;
+	flow_count = 0;
+	flow_sy = 0;
+	flow_siy = 0;
+}
+
+/**
+ * reset the regression window and the totalizer
+ */
+void flow_reset() {
+	flow_restart();
+	flow_total = 0;
+}
+
+/**
+ * reset the totalizer
+ */
+void flow_resettotal() {
+	flow_total = 0;
+}
+
+/**
+ * add a weight, return FLOW_REFILL if a refill is detected
+ */
+uint8_t flow_add(int32_t w, int32_t refillstep) {
+	if(flow_count) {
+		//refill
+		if(w - flow_last > refillstep) {
+			flow_restart();
+			flow_weights[0] = w;
+			flow_sy = w;
+			flow_count = 1;
+			flow_last = w;
+			return FLOW_REFILL;
+		}
+		flow_total += flow_last - w;
+	}
+	flow_last = w;
+
+	if(flow_count == FLOW_WINDOW) {
+		//slide, every index decreases by one
+		int32_t y0 = flow_weights[flow_head];
+		flow_siy += -(flow_sy - y0) + (int64_t)(FLOW_WINDOW-1)*w;
+		flow_sy += w - y0;
+		flow_weights[flow_head] = w;
+		flow_head = (flow_head + 1) % FLOW_WINDOW;
+	} else {
+		//fill
+		flow_siy += (int64_t)flow_count*w;
+		flow_sy += w;
+		flow_weights[(flow_head + flow_count) % FLOW_WINDOW] = w;
+		flow_count++;
+	}
+
+	return FLOW_WEIGHT;
+}
+
+/**
+ * get the number of weights in the window
+ */
+uint8_t flow_getcount() {
+	return flow_count;
+}
+
+/**
+ * get the slope in units per weight period
+ * slope = (n*Siy - Si*Sy) / (n*Sii - Si^2), Si = n(n-1)/2, Sii = n(n-1)(2n-1)/6
+ */
+double flow_getslope() {
+	int64_t n = flow_count;
+	int64_t si = 0;
+	int64_t sii = 0;
+
+	if(n < 2)
+		return 0;
+	si = n*(n-1)/2;
+	sii = n*(n-1)*(2*n-1)/6;
+	return (double)(n*flow_siy - si*flow_sy)/(double)(n*sii - si*si);
+}
+
+/**
+ * get the totalizer, weight lost
+ */
+int64_t flow_gettotal() {
+	return flow_total;
+}
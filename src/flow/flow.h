@@ -0,0 +1,43 @@
+/*
+flow lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + loss in weight flow rate, the slope of a least squares line over the
+    last FLOW_WINDOW filtered weights, the sums are updated in O(1) for
+    every weight with exact 64 bits integer math
+  + the totalizer adds the weight lost between consecutive weights, a rise
+    larger than the refill step is a refill, it is not totalized and the
+    regression window restarts
+  + weights are integers in any unit (es. x1000), the slope is in units
+    per weight period
+*/
+
+#include <avr/io.h>
+
+
+#ifndef FLOW_H_
+#define FLOW_H_
+
+
+//regression window, weights
+#define FLOW_WINDOW 16
+
+//add return codes
+#define FLOW_WEIGHT 0
+#define FLOW_REFILL 1
+
+//functions
+extern void flow_reset();
+extern void flow_restart();
+extern void flow_resettotal();
+extern uint8_t flow_add(int32_t w, int32_t refillstep);
+extern uint8_t flow_getcount();
+extern double flow_getslope();
+extern int64_t flow_gettotal();
+
+#endif
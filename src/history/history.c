@@ -0,0 +1,188 @@
+/*
+history lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+*/
+
+
+#include "history.h"
+
+#include <stdio.h>
+#include <avr/io.h>
+
+
+//ring of encoded differences
+static uint8_t history_ring[HISTORY_SIZE];
+static uint8_t history_tail = 0;
+static uint8_t history_len = 0;
+
+//oldest and newest sample
+static int32_t history_first = 0;
+static int32_t history_last = 0;
+
+//samples, samples before the trigger
+static uint16_t history_count = 0;
+static uint16_t history_pre = 0;
+
+//trigger
+static uint8_t history_triggered = 0;
+static uint8_t history_post = 0;
+static uint8_t history_frozen = 0;
+
+/**
+ * decode the varint at the ring position, return the number of bytes
+ */
+static uint8_t history_decode(uint8_t pos, int32_t *d) {
+	uint32_t z = 0;
+	uint8_t len = 0;
+	uint8_t b = 0;
+
+	do {
+		b = history_ring[(uint8_t)(pos + len) % HISTORY_SIZE];
+		z |= (uint32_t)(b & 0x7F) << (7*len);
+		len++;
+	} while((b & 0x80) && len < 5);
+	*d = (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+	return len;
+}
+
+/**
+ * release the frozen history and restart
+ */
+void history_release() {
+	history_tail = 0;
+	history_len = 0;
+	history_count = 0;
+	history_pre = 0;
+	history_triggered = 0;
+	history_frozen = 0;
+}
+
+/**
+ * add a sample
+ */
+void history_add(int32_t x) {
+	uint8_t buf[5];
+	uint8_t len = 0;
+	uint32_t z = 0;
+	uint8_t i = 0;
+
+	if(history_frozen)
+		return;
+
+	if(history_count == 0) {
+		history_first = x;
+	} else {
+		//zig-zag varint of the difference
+		int32_t d = x - history_last;
+		z = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+		do {
+			buf[len] = z & 0x7F;
+			z >>= 7;
+			if(z)
+				buf[len] |= 0x80;
+			len++;
+		} while(z);
+
+		//drop the oldest samples
+		while(HISTORY_SIZE - history_len < len) {
+			int32_t d0 = 0;
+			uint8_t l0 = history_decode(history_tail, &d0);
+			history_first += d0;
+			history_tail = (history_tail + l0) % HISTORY_SIZE;
+			history_len -= l0;
+			history_count--;
+			if(history_pre)
+				history_pre--;
+		}
+
+		//write
+		for(i=0; i<len; i++)
+			history_ring[(uint8_t)(history_tail + history_len + i) % HISTORY_SIZE] = buf[i];
+		history_len += len;
+	}
+	history_last = x;
+	history_count++;
+
+	//post trigger
+	if(history_triggered) {
+		history_post--;
+		if(history_post == 0)
+			history_frozen = 1;
+	}
+}
+
+/**
+ * trigger the history, it freezes after the post trigger samples
+ */
+void history_trigger() {
+	if(history_triggered)
+		return;
+	history_triggered = 1;
+	history_pre = history_count;
+	history_post = HISTORY_POSTSAMPLES;
+}
+
+/**
+ * check if the history is frozen
+ */
+uint8_t history_isfrozen() {
+	return history_frozen;
+}
+
+/**
+ * get the number of samples
+ */
+uint16_t history_getcount() {
+	return history_count;
+}
+
+/**
+ * get the number of samples before the trigger, all if not triggered
+ */
+uint16_t history_getpre() {
+	if(!history_triggered)
+		return history_count;
+	return history_pre;
+}
+
+/**
+ * get the oldest sample
+ */
+int32_t history_getfirst() {
+	return history_first;
+}
+
+/**
+ * get the number of encoded bytes
+ */
+uint8_t history_getlen() {
+	return history_len;
+}
+
+/**
+ * get an encoded byte, 0 is the oldest
+ */
+uint8_t history_getbyte(uint8_t index) {
+	return history_ring[(uint8_t)(history_tail + index) % HISTORY_SIZE];
+}
+
+/**
+ * get a sample, 0 is the oldest, decoding from the oldest
+ */
+uint8_t history_get(uint16_t index, int32_t *x) {
+	uint8_t pos = history_tail;
+	int32_t d = 0;
+
+	if(index >= history_count)
+		return 0;
+	*x = history_first;
+	while(index--) {
+		pos = (pos + history_decode(pos, &d)) % HISTORY_SIZE;
+		*x += d;
+	}
+	return 1;
+}
@@ -0,0 +1,46 @@
+/*
+history lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + samples are stored in a byte ring as the difference from the previous
+    sample, zig-zag encoded to unsigned and written as a varint, 7 bits
+    for each byte, the msb set if another byte follows
+  + the oldest sample is kept as absolute value, when the ring is full the
+    oldest differences are dropped, at most 5 bytes are written and at most
+    5 samples are dropped for each sample, so adding is constant time
+  + history_trigger() starts the post trigger count, after
+    HISTORY_POSTSAMPLES samples the history is frozen until released
+  + scripts/historydecode.py decodes the uart dump of the ring
+*/
+
+#include <avr/io.h>
+
+
+#ifndef HISTORY_H_
+#define HISTORY_H_
+
+
+//ring size in bytes, power of 2, max 128
+#define HISTORY_SIZE 128
+
+//samples kept after the trigger
+#define HISTORY_POSTSAMPLES 32
+
+//functions
+extern void history_release();
+extern void history_add(int32_t x);
+extern void history_trigger();
+extern uint8_t history_isfrozen();
+extern uint16_t history_getcount();
+extern uint16_t history_getpre();
+extern int32_t history_getfirst();
+extern uint8_t history_getlen();
+extern uint8_t history_getbyte(uint8_t index);
+extern uint8_t history_get(uint16_t index, int32_t *x);
+
+#endif
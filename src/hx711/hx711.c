@@ -22,17 +22,160 @@ static uint8_t hx711_gain = 0;
 static double hx711_scale = 0;
 //actual offset
 static int32_t hx711_offset = 0;
+//actual rate
+static uint8_t hx711_rate = HX711_RATEDEFAULT;
+//conversion period (us), ready timeout (polls) and conversions in a 10 SPS period
+static uint32_t hx711_period = HX711_PERIOD10SPS;
+static uint16_t hx711_readytimeout = (uint16_t)(HX711_READYTIMEOUTPERIODS*(HX711_PERIOD10SPS/HX711_READYPOLLUS));
+static uint8_t hx711_oversampling = 1;
+//faults
+static uint8_t hx711_fault = 0;
+//last value read and identical reads count, for each channel
+static uint32_t hx711_last[2] = {0, 0};
+static uint8_t hx711_stuckcount[2] = {0, 0};
+//channel pattern, bit i set reads channel B in slot i
+static uint8_t hx711_pattern = 0;
+static uint8_t hx711_patternlen = 1;
+static uint8_t hx711_patternslot = 0;
+//conversions and channel A samples in a pattern, discards included
+static uint8_t hx711_patternconversions = 1;
+static uint8_t hx711_patternsamplesa = 1;
+//channel of the conversion in progress, selected by the previous read
+static uint8_t hx711_channel = HX711_CHANNELA;
+//conversions to discard from the one in progress, taken with the power up
+//gain or in the settling time after a channel switch
+static uint8_t hx711_discard = 0;
+//a blocking channel A read cuts a channel B burst
+static uint8_t hx711_hurry = 0;
+//last channel B value and samples count
+static uint32_t hx711_channelb = 0;
+static uint16_t hx711_channelbcount = 0;
+//background period measure timebase, 0 if not running, ready edge timestamp
+//of the conversion to read, last edge and intervals between consecutive edges
+static uint32_t (*hx711_measuretime)() = 0;
+static uint8_t hx711_dthigh = 0;
+static uint8_t hx711_edge = 0;
+static uint32_t hx711_edgeus = 0;
+static uint8_t hx711_measurelastvalid = 0;
+static uint32_t hx711_measurelast = 0;
+static uint32_t hx711_measuresum = 0;
+static uint8_t hx711_measurecount = 0;
+
+static void hx711_setperiod(uint32_t period);
 
 /**
- * read raw value
+ * timestamp the ready edge of a conversion, the output was seen high before
  */
-int32_t hx711_read() {
+static void hx711_stampedge() {
+	hx711_dthigh = 0;
+	if(hx711_measuretime) {
+		hx711_edgeus = hx711_measuretime();
+		hx711_edge = 1;
+	}
+}
+
+/**
+ * add a read conversion to the background period measure, only an interval
+ * between two timestamped edges is a period
+ */
+static void hx711_measureconversion() {
+	if(!hx711_measuretime)
+		return;
+	if(hx711_edge) {
+		//an interval off the period by half was stretched by a late timestamp
+		uint32_t interval = hx711_edgeus - hx711_measurelast;
+		if(hx711_measurelastvalid && interval > hx711_period/2 && interval < hx711_period + hx711_period/2) {
+			hx711_measuresum += interval;
+			hx711_measurecount++;
+		}
+		hx711_measurelast = hx711_edgeus;
+		hx711_measurelastvalid = 1;
+	} else {
+		hx711_measurelastvalid = 0;
+	}
+	hx711_edge = 0;
+
+	if(hx711_measurecount >= HX711_PERIODMEASURESBG) {
+		hx711_setperiod(hx711_measuresum/hx711_measurecount);
+		hx711_measuretime = 0;
+	}
+}
+
+/**
+ * move to the next slot of the pattern, channel A slots only if channela
+ */
+static void hx711_nextslot(uint8_t channela) {
+	do {
+		hx711_patternslot++;
+		if(hx711_patternslot >= hx711_patternlen)
+			hx711_patternslot = 0;
+	} while(channela && (hx711_pattern & (1<<hx711_patternslot)));
+	if(hx711_pattern & (1<<hx711_patternslot))
+		hx711_channel = HX711_CHANNELB;
+	else
+		hx711_channel = HX711_CHANNELA;
+}
+
+/**
+ * read a conversion, return the channel of the sample or HX711_SAMPLENONE
+ * on timeout, channel B samples are stored
+ */
+static uint8_t hx711_readsample(uint32_t *value) {
 	uint32_t count = 0;
 	uint8_t i = 0;
+	uint16_t wait = 0;
+	uint8_t channel = hx711_channel;
+	uint8_t discard = hx711_discard;
+	uint8_t pulses = 0;
+	uint8_t cut = 0;
 
 	//wait for the chip to became ready
-	while (HX711_DTPIN & (1<<HX711_DTPINNUM));
+	while (HX711_DTPIN & (1<<HX711_DTPINNUM)) {
+		if(wait++ >= hx711_readytimeout) {
+			hx711_fault |= HX711_FAULTTIMEOUT;
+			return HX711_SAMPLENONE;
+		}
+		hx711_dthigh = 1;
+		_delay_us(HX711_READYPOLLUS);
+	}
+	if(hx711_dthigh)
+		hx711_stampedge();
+
+	//the pulses after this conversion select the channel of the next one,
+	//a discarded conversion does not take a slot, its channel is kept
+	if(discard) {
+		hx711_discard--;
+		cut = (hx711_hurry && channel == HX711_CHANNELB);
+	}
+	if(!discard || cut) {
+		hx711_nextslot(hx711_hurry);
+		//the conversions in the settling time after a switch are discarded
+		if(hx711_channel != channel)
+			hx711_discard = HX711_SETTLEPERIODS;
+		else
+			hx711_discard = 0;
+	}
+	if(hx711_channel == HX711_CHANNELB)
+		pulses = HX711_GAINCHANNELB32;
+	else
+		pulses = hx711_gain;
 
+#if HX711_SPIENABLED == 1
+	//read data with three spi transfers, mosi keeps the rate pin level
+	SPCR |= (1<<SPE);
+	for(i=0;i<3;i++) {
+		SPDR = (hx711_rate == HX711_RATE80SPS) ? 0xFF : 0x00;
+		while(!(SPSR & (1<<SPIF)));
+		count = (count<<8) | SPDR;
+	}
+	SPCR &= ~(1<<SPE);
+	count ^= 0x800000;
+
+#if HX711_ATOMICMODEENABLED == 1
+	ATOMIC_BLOCK(ATOMIC_FORCEON)
+	{
+#endif
+#else
 #if HX711_ATOMICMODEENABLED == 1
 	ATOMIC_BLOCK(ATOMIC_FORCEON)
 	{
@@ -48,9 +191,10 @@ int32_t hx711_read() {
 			count++;
 	}
 	count ^= 0x800000;
+#endif
 
 	//set the channel and the gain
-	for (i=0; i<hx711_gain; i++) {
+	for (i=0; i<pulses; i++) {
 		HX711_SCKPORT |= (1<<HX711_SCKPINNUM);
 		asm volatile("nop");
 		HX711_SCKPORT &= ~(1<<HX711_SCKPINNUM);
@@ -59,14 +203,138 @@ int32_t hx711_read() {
 	}
 #endif
 
-	return count;
+	//check the rails, the xor moved them to 0xFFFFFF and 0
+	if(count == 0 || count == 0xFFFFFF)
+		hx711_fault |= HX711_FAULTRAIL;
+
+	//check a stuck value
+	if(count != hx711_last[channel])
+		hx711_stuckcount[channel] = 0;
+	else if(hx711_stuckcount[channel] < HX711_STUCKTIMES-1)
+		hx711_stuckcount[channel]++;
+	else
+		hx711_fault |= HX711_FAULTSTUCK;
+	hx711_last[channel] = count;
+
+	hx711_measureconversion();
+
+	*value = count;
+	if(discard)
+		return HX711_SAMPLEDISCARD;
+	if(channel == HX711_CHANNELB) {
+		hx711_channelb = count;
+		hx711_channelbcount++;
+	}
+
+	return channel;
+}
+
+/**
+ * check if the chip is ready, a conversion can be read without waiting,
+ * a ready channel B or discarded conversion is read here, so it is not ready
+ */
+uint8_t hx711_isready() {
+	uint32_t value = 0;
+	if(HX711_DTPIN & (1<<HX711_DTPINNUM)) {
+		hx711_dthigh = 1;
+		return 0;
+	}
+	if(hx711_dthigh)
+		hx711_stampedge();
+	if(hx711_channel == HX711_CHANNELA && !hx711_discard)
+		return 1;
+	hx711_readsample(&value);
+	return 0;
+}
+
+/**
+ * read raw value of channel A, on timeout the last value is returned
+ */
+int32_t hx711_read() {
+	uint32_t value = 0;
+	uint8_t channel = HX711_SAMPLENONE;
+
+	//read until a channel A sample, at least one slot of the pattern is A,
+	//a channel B burst in progress is cut to bound the wait
+	hx711_hurry = (hx711_channel == HX711_CHANNELB);
+	while(channel != HX711_CHANNELA) {
+		channel = hx711_readsample(&value);
+		if(channel == HX711_SAMPLENONE)
+			break;
+	}
+	hx711_hurry = 0;
+	if(channel == HX711_SAMPLENONE)
+		return hx711_last[HX711_CHANNELA];
+
+	return value;
+}
+
+/**
+ * set the channel pattern, bit i set reads channel B in slot i of len slots,
+ * each channel switch adds HX711_SETTLEPERIODS discarded conversions
+ */
+void hx711_setpattern(uint8_t pattern, uint8_t len) {
+	uint8_t i = 0;
+	uint8_t next = 0;
+
+	if(len < 1 || len > 8)
+		len = 1;
+	pattern &= (uint8_t)(0xFF >> (8 - len));
+	//keep a channel A slot
+	if(pattern == (uint8_t)(0xFF >> (8 - len)))
+		pattern &= ~1;
+	hx711_pattern = pattern;
+	hx711_patternlen = len;
+	hx711_patternslot = len - 1;
+
+	//count the channel A slots and the switches
+	hx711_patternconversions = len;
+	hx711_patternsamplesa = 0;
+	for(i=0; i<len; i++) {
+		next = (i+1 >= len) ? 0 : i+1;
+		if(!(pattern & (1<<i)))
+			hx711_patternsamplesa++;
+		if(((pattern>>i) ^ (pattern>>next)) & 1)
+			hx711_patternconversions += HX711_SETTLEPERIODS;
+	}
+	hx711_setperiod(hx711_period);
+}
+
+/**
+ * get the last channel B raw value
+ */
+int32_t hx711_getchannelb() {
+	return hx711_channelb;
+}
+
+/**
+ * get the channel B samples count
+ */
+uint16_t hx711_getchannelbcount() {
+	return hx711_channelbcount;
+}
+
+/**
+ * get the faults
+ */
+uint8_t hx711_getfault() {
+	return hx711_fault;
+}
+
+/**
+ * clear the faults
+ */
+void hx711_clearfault() {
+	hx711_fault = 0;
+	hx711_stuckcount[HX711_CHANNELA] = 0;
+	hx711_stuckcount[HX711_CHANNELB] = 0;
 }
 
 /**
  * read raw value using average
  */
 int32_t hx711_readaverage(uint8_t times) {
-	int32_t sum = 0;
+	int64_t sum = 0;
 	uint8_t i = 0;
 	for (i=0; i<times; i++) {
 		sum += hx711_read();
@@ -75,13 +343,13 @@ int32_t hx711_readaverage(uint8_t times) {
 }
 
 /**
- * perform a read excluding tare
+ * perform a read excluding tare, the conversions of a 10 SPS period are averaged
  */
 double hx711_readwithtare() {
 #if HX711_USEAVERAGEONREAD == 1
-	return (double)hx711_readaverage(HX711_READTIMES)-(double)hx711_offset;
+	return (double)hx711_readaverage(HX711_READTIMES*hx711_oversampling)-(double)hx711_offset;
 #else
-	return (double)hx711_read()-(double)hx711_offset;
+	return (double)hx711_readaverage(hx711_oversampling)-(double)hx711_offset;
 #endif
 }
 
@@ -116,6 +384,109 @@ uint16_t hx711_getgain() {
 	return hx711_gain;
 }
 
+/**
+ * set the period, derive the ready timeout and the oversampling, the channel
+ * A samples in a 10 SPS period
+ */
+static void hx711_setperiod(uint32_t period) {
+	uint32_t timeout = HX711_READYTIMEOUTPERIODS*(period/HX711_READYPOLLUS);
+	uint32_t conversions = period*hx711_patternconversions;
+	uint32_t oversampling = (HX711_PERIOD10SPS*hx711_patternsamplesa + conversions/2)/conversions;
+
+	hx711_period = period;
+	hx711_readytimeout = timeout > 0xFFFF ? 0xFFFF : timeout;
+	hx711_oversampling = oversampling < 1 ? 1 : (oversampling > 8 ? 8 : oversampling);
+}
+
+/**
+ * set the rate, the period is set to the nominal one until measured
+ */
+void hx711_setrate(uint8_t rate) {
+	hx711_rate = rate;
+#if HX711_RATEPINENABLED == 1
+	if(rate == HX711_RATE80SPS)
+		HX711_RATEPORT |= (1<<HX711_RATEPINNUM);
+	else
+		HX711_RATEPORT &= ~(1<<HX711_RATEPINNUM);
+#endif
+	hx711_setperiod(rate == HX711_RATE80SPS ? HX711_PERIOD80SPS : HX711_PERIOD10SPS);
+}
+
+/**
+ * get the actual rate
+ */
+uint8_t hx711_getrate() {
+	return hx711_rate;
+}
+
+/**
+ * measure the conversion period (us) between the first and the last of
+ * HX711_PERIODMEASURES+1 ready edges, timestamped by the gettimeus timebase,
+ * return 0 and keep the previous period on timeout
+ */
+uint32_t hx711_measureperiod(uint32_t (*gettimeus)()) {
+	uint32_t start = 0;
+	uint32_t value = 0;
+	uint16_t wait = 0;
+	uint8_t i = 0;
+
+	hx711_measuretime = 0;
+
+	//sync on a conversion
+	hx711_readsample(&value);
+	for(i=0; i<=HX711_PERIODMEASURES; i++) {
+		wait = 0;
+		while (HX711_DTPIN & (1<<HX711_DTPINNUM)) {
+			if(wait++ >= hx711_readytimeout) {
+				hx711_fault |= HX711_FAULTTIMEOUT;
+				return 0;
+			}
+			_delay_us(HX711_READYPOLLUS);
+		}
+		if(i == 0)
+			start = gettimeus();
+		else if(i == HX711_PERIODMEASURES)
+			hx711_setperiod((gettimeus() - start)/HX711_PERIODMEASURES);
+		hx711_readsample(&value);
+	}
+
+	return hx711_period;
+}
+
+/**
+ * start measuring the conversion period in background, over the ready edges
+ * seen by hx711_isready() and by the reads, timestamped by the gettimeus
+ * timebase, the conversions must be read until the measure ends
+ */
+void hx711_measurestart(uint32_t (*gettimeus)()) {
+	hx711_measuresum = 0;
+	hx711_measurecount = 0;
+	hx711_measurelastvalid = 0;
+	hx711_edge = 0;
+	hx711_measuretime = gettimeus;
+}
+
+/**
+ * check if a background period measure is running
+ */
+uint8_t hx711_ismeasuring() {
+	return hx711_measuretime != 0;
+}
+
+/**
+ * get the conversion period (us)
+ */
+uint32_t hx711_getperiod() {
+	return hx711_period;
+}
+
+/**
+ * get the conversions read for each 10 SPS period
+ */
+uint8_t hx711_getoversampling() {
+	return hx711_oversampling;
+}
+
 /**
  * set the scale to use
  */
@@ -165,10 +536,32 @@ void hx711_powerdown() {
 }
 
 /**
- * power up the chip
+ * power up the chip, it restarts on channel A gain 128
  */
 void hx711_powerup() {
 	HX711_SCKPORT &= ~(1<<HX711_SCKPINNUM);
+	hx711_channel = HX711_CHANNELA;
+	hx711_patternslot = hx711_patternlen - 1;
+	hx711_discard = (hx711_gain != HX711_GAINCHANNELA128);
+	//the conversions of a background measure restart from here
+	hx711_measurelastvalid = 0;
+	hx711_edge = 0;
+}
+
+/**
+ * get the time (us) from the power up to a settled read of the filter samples
+ */
+uint32_t hx711_getwaketime() {
+#if HX711_USEAVERAGEONREAD == 1
+	uint16_t samples = HX711_READTIMES*hx711_oversampling;
+#else
+	uint16_t samples = hx711_oversampling;
+#endif
+	//conversions for the channel A samples, discards included
+	samples = (samples*hx711_patternconversions + hx711_patternsamplesa-1)/hx711_patternsamplesa;
+	if(hx711_gain != HX711_GAINCHANNELA128)
+		samples++;
+	return hx711_period*(HX711_SETTLEPERIODS + samples);
 }
 
 /**
@@ -194,6 +587,17 @@ void hx711_init(uint8_t gain, double scale, int32_t offset) {
 	HX711_SCKPORT &= ~(1<<HX711_SCKPINNUM);
 	//set dt as input
 	HX711_DTDDR &=~ (1<<HX711_DTPINNUM);
+#if HX711_SPIENABLED == 1
+	//set spi master, mode 1, fosc/4, enabled during the reads only
+	SPCR = (1<<MSTR) | (1<<CPHA);
+	SPSR &= ~(1<<SPI2X);
+#endif
+#if HX711_RATEPINENABLED == 1
+	//set rate as output
+	HX711_RATEDDR |= (1<<HX711_RATEPINNUM);
+#endif
+	//set rate
+	hx711_setrate(hx711_rate);
 
 	//set gain
 	hx711_setgain(gain);
@@ -12,6 +12,31 @@ Reference:
   + Other reference are
     https://github.com/getsiddd/HX711
     https://bitbucket.org/tmfret/avr-hx711-library/src/master/
+
+Notes:
+  + the gain pulses after a read select the channel of the next conversion,
+    so a sample belongs to the channel selected by the previous read
+  + channel A and B reads are interleaved by a pattern of up to 8 slots,
+    hx711_read() returns the next channel A sample and stores the channel
+    B ones, the HX711_SETTLEPERIODS conversions after a channel switch
+    are not settled and are discarded, so B slots are better grouped in
+    a burst, the oversampling counts the discarded conversions
+  + hx711_isready() reads a channel B burst in background, a blocking
+    hx711_read() cuts the burst in progress and switches back to channel
+    A, so it waits at most HX711_SETTLEPERIODS+2 conversions
+  + the chip wakes up on channel A gain 128, with another gain the first
+    conversion after hx711_powerup() is discarded to select it
+  + hx711_measureperiod() blocks for HX711_PERIODMEASURES+2 conversions,
+    hx711_measurestart() measures in background the interval between the
+    ready edges of consecutive conversions, an edge is timestamped when
+    hx711_isready() or a read sees the output go low, so the timestamp
+    jitter is the main loop pass, averaged over HX711_PERIODMEASURESBG
+    periods
+  + with the spi transport the 24 bits are read by three hardware spi
+    transfers (mode 1, fosc/4) with interrupts enabled, the spi clock
+    idles low so an interrupt between bytes can not power the chip down,
+    only the gain pulses are sent by gpio with interrupts masked. SS (PB2)
+    must be an output, MOSI (PB3) sends the rate pin level
 */
 
 #include <avr/io.h>
@@ -21,14 +46,10 @@ Reference:
 #define HX711_H_
 
 
-//set ports and pins
-#define HX711_DTPORT PORTB
-#define HX711_DTDDR DDRB
-#define HX711_DTPIN PINB
-#define HX711_DTPINNUM PB0
-#define HX711_SCKPORT PORTB
-#define HX711_SCKDDR DDRB
-#define HX711_SCKPINNUM PB1
+//ports and pins, set by the board revision, with HX711_SPIENABLED dt is
+//on MISO and sck on SCK, with HX711_RATEPINENABLED the rate pin drives the
+//RATE input, low 10 SPS, high 80 SPS, else the rate is only measured
+#include "../board/board.h"
 
 //defines gain
 #define HX711_GAINCHANNELA128 1
@@ -36,6 +57,12 @@ Reference:
 #define HX711_GAINCHANNELB32 2
 #define HX711_GAINDEFAULT HX711_GAINCHANNELA128
 
+//defines channels, HX711_SAMPLENONE is a read without sample
+#define HX711_CHANNELA 0
+#define HX711_CHANNELB 1
+#define HX711_SAMPLENONE 0xFF
+#define HX711_SAMPLEDISCARD 0xFE
+
 //defines scale
 #define HX711_SCALEDEFAULT 10000
 
@@ -54,13 +81,55 @@ Reference:
 //enable the atomic mode on shift in
 #define HX711_ATOMICMODEENABLED 1
 
+//defines rate
+#define HX711_RATE10SPS 0
+#define HX711_RATE80SPS 1
+#define HX711_RATEDEFAULT HX711_RATE10SPS
+
+//nominal conversion periods (us)
+#define HX711_PERIOD10SPS 100000
+#define HX711_PERIOD80SPS 12500
+
+//conversions measured for the period, at 10 SPS the measure takes
+//HX711_PERIODMEASURES+1 periods, and periods averaged by the background measure
+#define HX711_PERIODMEASURES 4
+#define HX711_PERIODMEASURESBG 16
+
+//output settling time after power up or a channel switch (conversion periods)
+#define HX711_SETTLEPERIODS 4
+
+//ready wait timeout (conversion periods) and polling step (us)
+#define HX711_READYTIMEOUTPERIODS 4
+#define HX711_READYPOLLUS 10
+
+//identical consecutive reads of a stuck value
+#define HX711_STUCKTIMES 16
+
+//faults, latched until cleared
+#define HX711_FAULTTIMEOUT (1<<0) //not ready within the timeout
+#define HX711_FAULTRAIL (1<<1) //output at the 0x7FFFFF or 0x800000 rail
+#define HX711_FAULTSTUCK (1<<2) //same value HX711_STUCKTIMES times
+
 //functions
+extern uint8_t hx711_isready();
 extern int32_t hx711_read();
+extern uint8_t hx711_getfault();
+extern void hx711_clearfault();
 extern int32_t hx711_readaverage(uint8_t times);
 extern double hx711_readwithtare();
 extern double hx711_getweight();
 extern void hx711_setgain(uint16_t gain);
 extern uint16_t hx711_getgain();
+extern void hx711_setpattern(uint8_t pattern, uint8_t len);
+extern int32_t hx711_getchannelb();
+extern uint16_t hx711_getchannelbcount();
+extern void hx711_setrate(uint8_t rate);
+extern uint8_t hx711_getrate();
+extern uint32_t hx711_measureperiod(uint32_t (*gettimeus)());
+extern void hx711_measurestart(uint32_t (*gettimeus)());
+extern uint8_t hx711_ismeasuring();
+extern uint32_t hx711_getperiod();
+extern uint8_t hx711_getoversampling();
 extern void hx711_setscale(double scale);
 extern double hx711_getscale();
 extern void hx711_setoffset(int32_t offset);
@@ -68,6 +137,7 @@ extern int32_t hx711_getoffset();
 extern void hx711_taretozero();
 extern void hx711_powerdown();
 extern void hx711_powerup();
+extern uint32_t hx711_getwaketime();
 extern void hx711_calibrate1setoffset();
 extern void hx711_calibrate2setscale(double weight);
 extern void hx711_init(uint8_t gain, double scale, int32_t offset);
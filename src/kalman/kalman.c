@@ -0,0 +1,139 @@
+/*
+kalman lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+*/
+
+
+#include "kalman.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <avr/io.h>
+
+
+//state, mass Q7 and rate Q16
+static int32_t kalman_mass = 0;
+static int32_t kalman_rate = 0;
+static uint8_t kalman_started = 0;
+
+//steady state gains, Q24
+static int32_t kalman_k0 = 0;
+static int32_t kalman_k1 = 0;
+
+//steady state rate variance
+static double kalman_ratevar = 0;
+
+//samples after a reset and samples to settle
+static uint16_t kalman_samples = 0;
+static uint16_t kalman_settlesamples = 0;
+
+/**
+ * restart the filter, the next sample sets the mass
+ */
+void kalman_reset() {
+	kalman_started = 0;
+	kalman_mass = 0;
+	kalman_rate = 0;
+	kalman_samples = 0;
+}
+
+/**
+ * set the process noise q of the rate and the measurement noise r, variances in counts, and restart,
+ * the steady state gains are computed here, F = [1 1; 0 1], H = [1 0], Q = [0 0; 0 q]
+ */
+void kalman_init(double q, double r) {
+	uint8_t i = 0;
+	double lo = 0;
+	double hi = 1;
+	double k0 = 0;
+	double k1 = 0;
+
+	if(r <= 0)
+		r = 1;
+	if(q < 0)
+		q = 0;
+
+	//the steady state riccati equation gives k1 = k0^2/(2-k0) and
+	//k1^2 = q/r*(1-k0), k0 is the root of k0^4 = q/r*(1-k0)*(2-k0)^2 in [0, 1)
+	for(i=0; i<KALMAN_ROOTITERATIONS; i++) {
+		k0 = (lo + hi)/2;
+		if(k0*k0*k0*k0 < q/r*(1-k0)*(2-k0)*(2-k0))
+			lo = k0;
+		else
+			hi = k0;
+	}
+	k1 = k0*k0/(2-k0);
+	kalman_k0 = lround(k0*(1L<<KALMAN_GAINSHIFT));
+	kalman_k1 = lround(k1*(1L<<KALMAN_GAINSHIFT));
+
+	//rate variance after the update
+	kalman_ratevar = r*k0*k1/(1-k0);
+
+	//the errors decay by the spectral radius of (I-KH)F for each sample, the
+	//filter is settled when a reset rate error of variance r decays under
+	//the steady state rate variance
+	double t = 2 - k0 - k1;
+	double d = t*t - 4*(1-k0);
+	double rho = (d < 0 ? sqrt(1-k0) : (t + sqrt(d))/2);
+	kalman_settlesamples = 0xFFFF;
+	if(rho < 1 && kalman_ratevar > 0) {
+		double n = ceil(log(kalman_ratevar/r)/(2*log(rho)));
+		if(n < 0xFFFF)
+			kalman_settlesamples = (n > 1 ? (uint16_t)n : 1);
+	}
+
+	kalman_reset();
+}
+
+/**
+ * filter a sample
+ */
+void kalman_update(int32_t z) {
+	if(!kalman_started) {
+		kalman_started = 1;
+		kalman_mass = z << KALMAN_MASSSHIFT;
+		return;
+	}
+	if(kalman_samples < kalman_settlesamples)
+		kalman_samples++;
+
+	//predict
+	kalman_mass += kalman_rate >> (KALMAN_RATESHIFT - KALMAN_MASSSHIFT);
+
+	//correct by the residual
+	int32_t e = (z << KALMAN_MASSSHIFT) - kalman_mass;
+	kalman_mass += (int32_t)(((int64_t)e * kalman_k0) >> KALMAN_GAINSHIFT);
+	kalman_rate += (int32_t)(((int64_t)e * kalman_k1) >> (KALMAN_GAINSHIFT + KALMAN_MASSSHIFT - KALMAN_RATESHIFT));
+}
+
+/**
+ * check if the filter settled after the last reset
+ */
+uint8_t kalman_issettled() {
+	return (kalman_started && kalman_samples >= kalman_settlesamples);
+}
+
+/**
+ * get the mass, counts
+ */
+int32_t kalman_getmass() {
+	return kalman_mass >> KALMAN_MASSSHIFT;
+}
+
+/**
+ * get the rate, counts for each sample
+ */
+double kalman_getrate() {
+	return (double)kalman_rate/(1L<<KALMAN_RATESHIFT);
+}
+
+/**
+ * get the steady state rate variance, counts for each sample squared
+ */
+double kalman_getratevar() {
+	return kalman_ratevar;
+}
@@ -0,0 +1,47 @@
+/*
+kalman lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + two state filter of the tared raw samples, mass and mass rate for each
+    sample, constant rate model, the process noise is on the rate
+  + the state is fixed point, mass Q7 counts and rate Q16 counts for each
+    sample, a float would lose the low bits of a 24 bits count, the gains
+    are Q24 and each sample costs two 64 bits products
+  + the gains are the steady state ones, computed in float by
+    kalman_init() only, so a sample costs no float operation, the rate
+    variance is the steady state one
+  + the first sample after a reset sets the mass, the rate starts at 0,
+    kalman_issettled() tells when the rate error of the reset decayed
+    under the steady state rate variance
+*/
+
+#include <avr/io.h>
+
+
+#ifndef KALMAN_H_
+#define KALMAN_H_
+
+
+//fixed point fraction bits
+#define KALMAN_MASSSHIFT 7
+#define KALMAN_RATESHIFT 16
+#define KALMAN_GAINSHIFT 24
+
+//bisection steps of the steady state gain
+#define KALMAN_ROOTITERATIONS 32
+
+//functions
+extern void kalman_init(double q, double r);
+extern void kalman_reset();
+extern void kalman_update(int32_t z);
+extern uint8_t kalman_issettled();
+extern int32_t kalman_getmass();
+extern double kalman_getrate();
+extern double kalman_getratevar();
+
+#endif
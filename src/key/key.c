@@ -83,6 +83,23 @@ uint8_t key_getlong(uint8_t key_mask) {
 	return key_getpress( key_getrpt( key_mask ) );
 }
 
+/*
+ * check if all the keys are pressed for long time, the keys are kept if
+ * not all of them are, the long press of every held key is set at once so
+ * check it before the single keys
+ */
+uint8_t key_getlongall(uint8_t key_mask) {
+	uint8_t ret = 0;
+	cli();
+	if((key_rpt & key_press & key_mask) == key_mask) {
+		key_rpt ^= key_mask; // clear key(s)
+		key_press ^= key_mask;
+		ret = key_mask;
+	}
+	sei();
+	return ret;
+}
+
 /*
  * init the key functions
  */
@@ -23,12 +23,8 @@ Notes:
 #ifndef KEY_H_
 #define KEY_H_
 
-//setup button port
-#define KEY_DDR DDRC
-#define KEY_PIN PINC
-#define KEY_BUTTON1 PC0
-#define KEY_BUTTON2 PC1
-#define KEY_BUTTON3 PC2
+//setup button port, set by the board revision
+#include "../board/board.h"
 
 //setup repeat keymask for longpress buttons
 #define KEY_REPEATMASK (1<<KEY_BUTTON1 ^ 1<<KEY_BUTTON2 ^ 1<<KEY_BUTTON3)
@@ -43,5 +39,6 @@ extern uint8_t key_getpress(uint8_t key_mask);
 extern uint8_t key_getrpt(uint8_t key_mask);
 extern uint8_t key_getshort(uint8_t key_mask);
 extern uint8_t key_getlong(uint8_t key_mask);
+extern uint8_t key_getlongall(uint8_t key_mask);
 
 #endif
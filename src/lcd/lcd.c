@@ -25,6 +25,7 @@
 #include <inttypes.h>
 #include <avr/io.h>
 #include <avr/pgmspace.h>
+#include <util/atomic.h>
 #include "lcd.h"
 
 
@@ -41,6 +42,13 @@
 #endif
 
 
+#if LCD_IO_MODE
+/* data lines on contiguous pins of one port, constant folded by the compiler */
+#define LCD_DATANIBBLE ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT ) \
+      && (LCD_DATA1_PIN == LCD_DATA0_PIN+1) && (LCD_DATA2_PIN == LCD_DATA0_PIN+2) && (LCD_DATA3_PIN == LCD_DATA0_PIN+3) )
+#define LCD_DATAMASK (0x0F << LCD_DATA0_PIN)
+#endif
+
 #if LCD_IO_MODE
 #define lcd_e_delay()   __asm__ __volatile__( "rjmp 1f\n 1:" );
 #define lcd_e_high()    LCD_E_PORT  |=  _BV(LCD_E_PIN);
@@ -144,23 +152,26 @@ static void lcd_write(uint8_t data,uint8_t rs)
     }
     lcd_rw_low();
 
-    if ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT )
-      && (LCD_DATA0_PIN == 0) && (LCD_DATA1_PIN == 1) && (LCD_DATA2_PIN == 2) && (LCD_DATA3_PIN == 3) )
+    if ( LCD_DATANIBBLE )
     {
         /* configure data pins as output */
-        DDR(LCD_DATA0_PORT) |= 0x0F;
+        DDR(LCD_DATA0_PORT) |= LCD_DATAMASK;
 
+        /* the other pins of the port may be changed by interrupts */
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
         /* output high nibble first */
-        dataBits = LCD_DATA0_PORT & 0xF0;
-        LCD_DATA0_PORT = dataBits |((data>>4)&0x0F);
+        dataBits = LCD_DATA0_PORT & ~LCD_DATAMASK;
+        LCD_DATA0_PORT = dataBits | (((data>>4)&0x0F) << LCD_DATA0_PIN);
         lcd_e_toggle();
 
         /* output low nibble */
-        LCD_DATA0_PORT = dataBits | (data&0x0F);
+        LCD_DATA0_PORT = dataBits | ((data&0x0F) << LCD_DATA0_PIN);
         lcd_e_toggle();
 
         /* all data pins high (inactive) */
-        LCD_DATA0_PORT = dataBits | 0x0F;
+        LCD_DATA0_PORT = dataBits | LCD_DATAMASK;
+        }
     }
     else
     {
@@ -224,21 +235,20 @@ static uint8_t lcd_read(uint8_t rs)
         lcd_rs_low();                        /* RS=0: read busy flag */
     lcd_rw_high();                           /* RW=1  read mode      */
     
-    if ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT )
-      && ( LCD_DATA0_PIN == 0 )&& (LCD_DATA1_PIN == 1) && (LCD_DATA2_PIN == 2) && (LCD_DATA3_PIN == 3) )
+    if ( LCD_DATANIBBLE )
     {
-        DDR(LCD_DATA0_PORT) &= 0xF0;         /* configure data pins as input */
+        DDR(LCD_DATA0_PORT) &= ~LCD_DATAMASK; /* configure data pins as input */
         
         lcd_e_high();
         lcd_e_delay();        
-        data = PIN(LCD_DATA0_PORT) << 4;     /* read high nibble first */
+        data = ((PIN(LCD_DATA0_PORT) >> LCD_DATA0_PIN)&0x0F) << 4; /* read high nibble first */
         lcd_e_low();
         
         lcd_e_delay();                       /* Enable 500ns low       */
         
         lcd_e_high();
         lcd_e_delay();
-        data |= PIN(LCD_DATA0_PORT)&0x0F;    /* read low nibble        */
+        data |= (PIN(LCD_DATA0_PORT) >> LCD_DATA0_PIN)&0x0F; /* read low nibble */
         lcd_e_low();
     }
     else
@@ -537,11 +547,10 @@ void lcd_init(uint8_t dispAttr)
         /* configure all port bits as output (all LCD lines on same port) */
         DDR(LCD_DATA0_PORT) |= 0x7F;
     }
-    else if ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT )
-           && (LCD_DATA0_PIN == 0 ) && (LCD_DATA1_PIN == 1) && (LCD_DATA2_PIN == 2) && (LCD_DATA3_PIN == 3) )
+    else if ( LCD_DATANIBBLE )
     {
         /* configure all port bits as output (all LCD data lines on same port, but control lines on different ports) */
-        DDR(LCD_DATA0_PORT) |= 0x0F;
+        DDR(LCD_DATA0_PORT) |= LCD_DATAMASK;
         DDR(LCD_RS_PORT)    |= _BV(LCD_RS_PIN);
         DDR(LCD_RW_PORT)    |= _BV(LCD_RW_PIN);
         DDR(LCD_E_PORT)     |= _BV(LCD_E_PIN);
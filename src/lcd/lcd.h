@@ -78,26 +78,14 @@
  *  Change LCD_RS_PORT, LCD_RW_PORT, LCD_E_PORT if you want the control lines on
  *  different ports. 
  *
- *  Normally the four data lines should be mapped to bit 0..3 on one port, but it
- *  is possible to connect these data lines in different order or even on different
- *  ports by adapting the LCD_DATAx_PORT and LCD_DATAx_PIN definitions.
+ *  Normally the four data lines should be mapped to contiguous bits on one port,
+ *  but it is possible to connect these data lines in different order or even on
+ *  different ports by adapting the LCD_DATAx_PORT and LCD_DATAx_PIN definitions.
+ *  The definitions are in board/board.h.
  *  
  */
 
-#define LCD_DATA0_PORT   PORTD        /**< port for 4bit data bit 0 */
-#define LCD_DATA1_PORT   PORTD        /**< port for 4bit data bit 1 */
-#define LCD_DATA2_PORT   PORTD        /**< port for 4bit data bit 2 */
-#define LCD_DATA3_PORT   PORTD        /**< port for 4bit data bit 3 */
-#define LCD_DATA0_PIN    4            /**< pin for 4bit data bit 0  */
-#define LCD_DATA1_PIN    5            /**< pin for 4bit data bit 1  */
-#define LCD_DATA2_PIN    6            /**< pin for 4bit data bit 2  */
-#define LCD_DATA3_PIN    7            /**< pin for 4bit data bit 3  */
-#define LCD_RS_PORT      PORTC        /**< port for RS line         */
-#define LCD_RS_PIN       5            /**< pin  for RS line         */
-#define LCD_RW_PORT      PORTC        /**< port for RW line         */
-#define LCD_RW_PIN       4            /**< pin  for RW line         */
-#define LCD_E_PORT       PORTC        /**< port for Enable line     */
-#define LCD_E_PIN        3            /**< pin  for Enable line     */
+#include "../board/board.h"   /* ports and pins of the board revision */
 
 #elif defined(__AVR_AT90S4414__) || defined(__AVR_AT90S8515__) || defined(__AVR_ATmega64__) || \
       defined(__AVR_ATmega8515__)|| defined(__AVR_ATmega103__) || defined(__AVR_ATmega128__) || \
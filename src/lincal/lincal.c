@@ -0,0 +1,95 @@
+/*
+lincal lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+*/
+
+
+#include "lincal.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <avr/io.h>
+
+
+//breakpoints
+static int32_t lincal_raw[LINCAL_POINTSMAX+1];
+static int32_t lincal_weight[LINCAL_POINTSMAX+1];
+//slope of the segment starting at each breakpoint
+static int32_t lincal_slope[LINCAL_POINTSMAX+1];
+//number of segments
+static uint8_t lincal_segments = 0;
+
+/**
+ * set the calibration points, return the number of segments, 0 if the table is not usable
+ */
+uint8_t lincal_setpoints(const lincal_pointt *points, uint8_t count) {
+	uint8_t n = 1;
+	uint8_t i = 0;
+	uint8_t j = 0;
+
+	//zero point
+	lincal_raw[0] = 0;
+	lincal_weight[0] = 0;
+
+	//insertion sort by raw value, points with the same raw value are skipped
+	if(count > LINCAL_POINTSMAX)
+		count = LINCAL_POINTSMAX;
+	for(i=0; i<count; i++) {
+		int32_t raw = points[i].raw;
+		int32_t weight = (int32_t)points[i].weight<<LINCAL_WEIGHTSHIFT;
+		for(j=0; j<n && lincal_raw[j] < raw; j++);
+		if(j < n && lincal_raw[j] == raw)
+			continue;
+		uint8_t k = n;
+		for(; k>j; k--) {
+			lincal_raw[k] = lincal_raw[k-1];
+			lincal_weight[k] = lincal_weight[k-1];
+		}
+		lincal_raw[j] = raw;
+		lincal_weight[j] = weight;
+		n++;
+	}
+
+	//compute slopes
+	lincal_segments = 0;
+	for(i=0; i<n-1; i++) {
+		int64_t slope = ((int64_t)(lincal_weight[i+1] - lincal_weight[i])<<LINCAL_SLOPESHIFT) / (lincal_raw[i+1] - lincal_raw[i]);
+		if(slope > INT32_MAX || slope < INT32_MIN)
+			return 0;
+		lincal_slope[i] = slope;
+	}
+	lincal_segments = n-1;
+
+	return lincal_segments;
+}
+
+/**
+ * get the number of segments
+ */
+uint8_t lincal_getsegments() {
+	return lincal_segments;
+}
+
+/**
+ * convert a tared raw value to weight, the table must have at least one segment
+ */
+int32_t lincal_convert(int32_t raw) {
+	uint8_t lo = 0;
+	uint8_t hi = lincal_segments;
+
+	//binary search the segment, lo is the last breakpoint not greater than raw,
+	//first and last segments extrapolate outside the table
+	while(hi - lo > 1) {
+		uint8_t mid = (lo + hi)>>1;
+		if(lincal_raw[mid] <= raw)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lincal_weight[lo] + (int32_t)(((int64_t)(raw - lincal_raw[lo]) * lincal_slope[lo])>>LINCAL_SLOPESHIFT);
+}
@@ -0,0 +1,46 @@
+/*
+lincal lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + piecewise linear conversion of a tared raw value to weight
+  + the breakpoint table is the zero point plus up to LINCAL_POINTSMAX
+    calibration points, sorted by raw value
+  + the slope of each segment is precomputed, a conversion is a binary
+    search and a 32x32 bit multiply, points outside the table are
+    extrapolated by the first and last segments
+  + weight is returned as fixed point with LINCAL_WEIGHTSHIFT fractional bits
+*/
+
+#include <avr/io.h>
+
+
+#ifndef LINCAL_H_
+#define LINCAL_H_
+
+
+//max number of calibration points
+#define LINCAL_POINTSMAX 8
+
+//weight fractional bits
+#define LINCAL_WEIGHTSHIFT 16
+
+//slope fractional bits, over the weight fractional bits
+#define LINCAL_SLOPESHIFT 16
+
+//calibration point
+typedef struct {
+	int32_t raw;
+	uint16_t weight;
+} lincal_pointt;
+
+//functions
+extern uint8_t lincal_setpoints(const lincal_pointt *points, uint8_t count);
+extern uint8_t lincal_getsegments();
+extern int32_t lincal_convert(int32_t raw);
+
+#endif
@@ -9,11 +9,15 @@ Please refer to LICENSE file for licensing information.
 
 #include "main.h"
 
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
 //button enabled
 volatile uint8_t key_enabled = 0;
 
 //machine state
-enum state {running, programming, calibration};
+enum state {running, programming, calibration, characterize, fault};
 enum state currentstate = running; //default state
 
 //onesec trigger
@@ -29,12 +33,139 @@ volatile uint8_t skip_state = 0;
 volatile uint8_t error_state = 0;
 
 //skip counters
-static uint16_t skip_intervalcounter = 0;
-static uint16_t skip_timecounter = 0;
+static uint32_t skip_intervalcounter = 0;
+static uint32_t skip_timecounter = 0;
+
+//last filtered weight read, tared
+static int32_t weight_lastraw = 0;
+
+#if WARMSTART_ENABLED == 1
+//warm restart state, not cleared at reset, valid if the crc matches
+typedef struct {
+	uint8_t error_state;
+	uint8_t skip_state;
+	uint32_t skip_intervalcounter;
+	uint32_t skip_timecounter;
+	double weight_previous;
+	uint8_t initweight_previous;
+	uint8_t weight_errors;
+	uint16_t resets_wdt;
+	uint16_t resets_bor;
+	uint16_t crc;
+} warmstart_t;
+static warmstart_t warmstart __attribute__((section(".noinit")));
+#endif
+
+#if EVENTLOG_ENABLED == 1
+//seconds from startup
+static volatile uint32_t uptime_seconds = 0;
+#if TELEMETRY_ENABLED == 1
+//next event log record to send, 0xFF if no dump is running
+static uint8_t telemetry_eventlogindex = 0xFF;
+#endif
+#endif
+
+//main timer steps, the timebase of the checkweigher and of the hx711 period
+static volatile uint32_t maintimer_steps = 0;
+
+//calibration sampler
+static uint8_t calsampler_running = 0;
+static uint8_t calsampler_seconds = 0;
+static stats_t calsampler_stats;
+
+#if CHARACTERIZE_ENABLED == 1
+//noise characterization
+static uint8_t characterize_running = 0;
+static uint16_t characterize_seconds = 0;
+static uint16_t characterize_time = CHARACTERIZE_TIME_DEFAULT;
+static noise_resultt characterize_unloaded;
+static noise_resultt characterize_loaded;
+static int16_t characterize_thresholddiff = 0;
+static uint8_t characterize_thresholderr = 0;
+static uint8_t characterize_applied = 0;
+#endif
+
+#if CHECKWEIGHER_ENABLED == 1
+//trigger timestamp, set by the trigger interrupt
+static volatile uint32_t checkweigher_triggerstep = 0;
+static volatile uint8_t checkweigher_triggered = 0;
+//steps after a trigger the next edges are ignored
+static volatile uint16_t checkweigher_lockout = 0;
+//samples read in the last second
+static uint8_t checkweigher_samples = 0;
+//item capture
+static uint8_t checkweigher_capturing = 0;
+static uint32_t checkweigher_step = 0;
+//settled window samples, the window mean is the item filter
+static stats_t checkweigher_window;
+//last item
+static double checkweigher_weight = 0;
+static uint8_t checkweigher_class = CHECKWEIGHER_CLASSOK;
+static uint32_t checkweigher_items = 0;
+#endif
+
+#if FLOWRATE_ENABLED == 1
+//flow rate block filter
+static int64_t flowrate_sum = 0;
+static uint16_t flowrate_count = 0;
+//flow rate, units per minute
+static double flowrate_rate = 0;
+#endif
+
+#if DUTYCYCLE_ENABLED == 1
+//converter powered down between the weight readings
+static uint8_t dutycycle_sleeping = 0;
+#endif
+
+#if KALMAN_ENABLED == 1
+//filtered conversions in this second and in the last second
+static uint8_t weight_kalmansamples = 0;
+static uint8_t weight_kalmansps = 0;
+//conversion period the filter noises are set for
+static uint32_t weight_kalmanperiod = 0;
+#endif
+
+#if RECIPE_INPUTENABLED == 1
+//recipe selected by the input
+static volatile uint8_t recipe_input = 0;
+#endif
+
+#if PRODSTATS_ENABLED == 1
+//production statistics, weights and diffs x1000
+typedef struct {
+	stats_t weight;
+	stats_t diff;
+	uint16_t alarms;
+	uint16_t histogram[PRODSTATS_HISTBINS];
+} prodstats_t;
+static prodstats_t prodstats;
+//show production statistics screen
+static uint8_t prodstats_show = 0;
+//current production statistics page
+static uint8_t prodstats_page = PRODSTATSPAGE_COUNT;
+//seconds left of the snapshot saved message
+static uint8_t prodstats_saved = 0;
+#endif
+
+#if DIAG_ENABLED == 1
+//show diagnostics screen
+static uint8_t diag_show = 0;
+//current diagnostics page
+static uint8_t diag_page = DIAGPAGE_LOOP;
+#endif
+
+//define the recipe structure
+typedef struct {
+	uint8_t getweight_interval;
+	uint8_t getweight_thresholderr;
+	int16_t getweight_thresholddiff;
+	uint16_t skip_interval;
+	uint16_t skip_time;
+} recipe_eet;
 
 //define the eeprom structure
 typedef struct {
-	uint8_t initeeprom;
+	uint8_t version; //was initeeprom, 1 on the first layout
 	uint8_t getweight_interval;
 	uint8_t getweight_thresholderr;
 	int16_t getweight_thresholddiff;
@@ -45,35 +176,474 @@ typedef struct {
 	int32_t weightcal_offset;
 	uint8_t weightcal_gain;
 	double weightcal_scale;
+	uint8_t recipe;
+	recipe_eet recipes[RECIPE_TOT];
+	uint8_t weightcal_rate;
 } eepromitem_eet;
-eepromitem_eet EEMEM  eepromitem_eemem;
+uint8_t EEMEM  eepromitem_eemem[EEPROMITEM_V1SIZE]; //legacy block, the configuration is now stored by the eeconf journal
 eepromitem_eet  eepromitem_eevar;
+_Static_assert(sizeof(eepromitem_eet) <= EECONF_CONFDATASIZE, "configuration exceeds the eeconf journal data size");
+
+//define the calibration table eeprom structure
+typedef struct {
+	uint8_t count;
+	lincal_pointt points[LINCAL_POINTSMAX];
+} eepromcal_eet;
+eepromcal_eet eepromcal_eevar;
+_Static_assert(sizeof(eepromcal_eet) <= EECONF_CALDATASIZE, "calibration table exceeds the eeconf journal data size");
+
+#if PRODSTATS_ENABLED == 1
+//define the production statistics snapshot stream structure
+typedef struct {
+	int32_t mean;
+	double variance;
+	int32_t min;
+	int32_t max;
+} statsstream_eet;
+
+//define the production statistics snapshot eeprom structure
+typedef struct {
+	uint32_t n;
+	uint16_t alarms;
+	statsstream_eet weight;
+	statsstream_eet diff;
+	uint8_t histogramshift;
+	uint8_t histogram[PRODSTATS_HISTBINS]; //bins shifted right by histogramshift
+} eepromstats_eet;
+eepromstats_eet eepromstats_eevar;
+_Static_assert(sizeof(eepromstats_eet) <= EECONF_STATSDATASIZE, "statistics snapshot exceeds the eeconf journal data size");
+#endif
+
+#if CHECKWEIGHER_ENABLED == 1
+//define the checkweigher band structure
+typedef struct {
+	uint16_t low; //x1000
+	uint16_t high; //x1000
+} band_eet;
+
+//define the checkweigher eeprom structure
+typedef struct {
+	uint8_t enabled;
+	uint16_t settle; //ms
+	uint16_t window; //ms
+	band_eet bands[RECIPE_TOT];
+	uint16_t reject_delay; //ms
+	uint16_t reject_width; //ms
+} eepromcw_eet;
+eepromcw_eet eepromcw_eevar;
+_Static_assert(sizeof(eepromcw_eet) <= EECONF_CWDATASIZE, "checkweigher configuration exceeds the eeconf journal data size");
+#endif
+
+#if FLOWRATE_ENABLED == 1
+//define the flow rate eeprom structure
+typedef struct {
+	uint8_t enabled;
+	uint16_t low; //units per minute x1000
+	uint16_t high; //units per minute x1000
+	uint16_t refill; //x1000
+} eepromflow_eet;
+eepromflow_eet eepromflow_eevar;
+_Static_assert(sizeof(eepromflow_eet) <= EECONF_FLOWDATASIZE, "flow rate configuration exceeds the eeconf journal data size");
+#endif
+
+#if KALMAN_ENABLED == 1
+//define the kalman filter eeprom structure
+typedef struct {
+	uint16_t noise; //x1000
+	uint16_t process; //x1000
+} eepromkf_eet;
+eepromkf_eet eepromkf_eevar;
+_Static_assert(sizeof(eepromkf_eet) <= EECONF_KFDATASIZE, "kalman filter configuration exceeds the eeconf journal data size");
+#endif
+
+//eeprom write requested, one bit for each journal
+static uint8_t eepromitem_writepending = 0;
+
+//runtime parameters, precomputed from the recipes
+typedef struct {
+	uint8_t getweight_interval;
+	uint8_t getweight_thresholderr;
+	double getweight_thresholddiff; //weight units
+	uint32_t skip_interval; //seconds
+	uint32_t skip_time; //seconds
+} runtime_t;
+static runtime_t runtime_recipes[RECIPE_TOT];
+//parameters of the active recipe
+static const runtime_t * volatile runtime = &runtime_recipes[0];
+
+//eeprom fields type
+#define EEPROMITEM_TYPEUINT8 0
+#define EEPROMITEM_TYPEUINT16 1
+#define EEPROMITEM_TYPEINT16 2
+#define EEPROMITEM_TYPEINT32 3
+#define EEPROMITEM_TYPEDOUBLE 4
+
+//eeprom fields validation table
+typedef struct {
+	uint8_t offset;
+	uint8_t type;
+	int32_t min;
+	int32_t max;
+	int32_t def;
+} eepromitem_fieldt;
+const eepromitem_fieldt eepromitem_fields[] PROGMEM = {
+	{ offsetof(eepromitem_eet, getweight_interval), EEPROMITEM_TYPEUINT8, GETWEIGHT_INTERVAL_MIN, GETWEIGHT_INTERVAL_MAX, GETWEIGHT_INTERVAL_DEFAULT },
+	{ offsetof(eepromitem_eet, getweight_thresholderr), EEPROMITEM_TYPEUINT8, GETWEIGHT_THRESHOLDERR_MIN, GETWEIGHT_THRESHOLDERR_MAX, GETWEIGHT_THRESHOLDERR_DEFAULT },
+	{ offsetof(eepromitem_eet, getweight_thresholddiff), EEPROMITEM_TYPEINT16, GETWEIGHT_THRESHOLDDIFF_MIN, GETWEIGHT_THRESHOLDDIFF_MAX, GETWEIGHT_THRESHOLDDIFF_DEFAULT },
+	{ offsetof(eepromitem_eet, alert_enabled), EEPROMITEM_TYPEUINT8, ALERT_ENABLED_MIN, ALERT_ENABLED_MAX, ALERT_ENABLED_DEFAULT },
+	{ offsetof(eepromitem_eet, skip_interval), EEPROMITEM_TYPEUINT16, SKIP_INTERVAL_MIN, SKIP_INTERVAL_MAX, SKIP_INTERVAL_DEFAULT },
+	{ offsetof(eepromitem_eet, skip_time), EEPROMITEM_TYPEUINT16, SKIP_TIME_MIN, SKIP_TIME_MAX, SKIP_TIME_DEFAULT },
+	{ offsetof(eepromitem_eet, weightcal_weight), EEPROMITEM_TYPEUINT16, WEIGHTCAL_WEIGHT_MIN, WEIGHTCAL_WEIGHT_MAX, WEIGHTCAL_WEIGHT_DEFAULT },
+	{ offsetof(eepromitem_eet, weightcal_offset), EEPROMITEM_TYPEINT32, WEIGHTCAL_OFFSET_MIN, WEIGHTCAL_OFFSET_MAX, WEIGHTCAL_OFFSET_DEFAULT },
+	{ offsetof(eepromitem_eet, weightcal_gain), EEPROMITEM_TYPEUINT8, WEIGHTCAL_GAIN_MIN, WEIGHTCAL_GAIN_MAX, WEIGHTCAL_GAIN_DEFAULT },
+	{ offsetof(eepromitem_eet, weightcal_scale), EEPROMITEM_TYPEDOUBLE, 0, 0, WEIGHTCAL_SCALE_DEFAULT },
+	{ offsetof(eepromitem_eet, recipe), EEPROMITEM_TYPEUINT8, 0, RECIPE_TOT-1, 0 },
+	{ offsetof(eepromitem_eet, weightcal_rate), EEPROMITEM_TYPEUINT8, WEIGHTCAL_RATE_MIN, WEIGHTCAL_RATE_MAX, WEIGHTCAL_RATE_DEFAULT }
+};
+#define EEPROMITEM_FIELDSTOT (sizeof(eepromitem_fields)/sizeof(eepromitem_fieldt))
+
+//recipe fields validation table
+const eepromitem_fieldt eepromitem_recipefields[] PROGMEM = {
+	{ offsetof(recipe_eet, getweight_interval), EEPROMITEM_TYPEUINT8, GETWEIGHT_INTERVAL_MIN, GETWEIGHT_INTERVAL_MAX, GETWEIGHT_INTERVAL_DEFAULT },
+	{ offsetof(recipe_eet, getweight_thresholderr), EEPROMITEM_TYPEUINT8, GETWEIGHT_THRESHOLDERR_MIN, GETWEIGHT_THRESHOLDERR_MAX, GETWEIGHT_THRESHOLDERR_DEFAULT },
+	{ offsetof(recipe_eet, getweight_thresholddiff), EEPROMITEM_TYPEINT16, GETWEIGHT_THRESHOLDDIFF_MIN, GETWEIGHT_THRESHOLDDIFF_MAX, GETWEIGHT_THRESHOLDDIFF_DEFAULT },
+	{ offsetof(recipe_eet, skip_interval), EEPROMITEM_TYPEUINT16, SKIP_INTERVAL_MIN, SKIP_INTERVAL_MAX, SKIP_INTERVAL_DEFAULT },
+	{ offsetof(recipe_eet, skip_time), EEPROMITEM_TYPEUINT16, SKIP_TIME_MIN, SKIP_TIME_MAX, SKIP_TIME_DEFAULT }
+};
+#define EEPROMITEM_RECIPEFIELDSTOT (sizeof(eepromitem_recipefields)/sizeof(eepromitem_fieldt))
+
+#if CHECKWEIGHER_ENABLED == 1
+//checkweigher fields validation table
+const eepromitem_fieldt eepromcw_fields[] PROGMEM = {
+	{ offsetof(eepromcw_eet, enabled), EEPROMITEM_TYPEUINT8, CHECKWEIGHER_ENABLED_MIN, CHECKWEIGHER_ENABLED_MAX, CHECKWEIGHER_ENABLED_DEFAULT },
+	{ offsetof(eepromcw_eet, settle), EEPROMITEM_TYPEUINT16, CHECKWEIGHER_SETTLE_MIN, CHECKWEIGHER_SETTLE_MAX, CHECKWEIGHER_SETTLE_DEFAULT },
+	{ offsetof(eepromcw_eet, window), EEPROMITEM_TYPEUINT16, CHECKWEIGHER_WINDOW_MIN, CHECKWEIGHER_WINDOW_MAX, CHECKWEIGHER_WINDOW_DEFAULT },
+	{ offsetof(eepromcw_eet, reject_delay), EEPROMITEM_TYPEUINT16, REJECT_DELAY_MIN, REJECT_DELAY_MAX, REJECT_DELAY_DEFAULT },
+	{ offsetof(eepromcw_eet, reject_width), EEPROMITEM_TYPEUINT16, REJECT_WIDTH_MIN, REJECT_WIDTH_MAX, REJECT_WIDTH_DEFAULT }
+};
+#define EEPROMCW_FIELDSTOT (sizeof(eepromcw_fields)/sizeof(eepromitem_fieldt))
+
+//checkweigher band fields validation table
+const eepromitem_fieldt eepromcw_bandfields[] PROGMEM = {
+	{ offsetof(band_eet, low), EEPROMITEM_TYPEUINT16, CHECKWEIGHER_BAND_MIN, CHECKWEIGHER_BAND_MAX, CHECKWEIGHER_LOW_DEFAULT },
+	{ offsetof(band_eet, high), EEPROMITEM_TYPEUINT16, CHECKWEIGHER_BAND_MIN, CHECKWEIGHER_BAND_MAX, CHECKWEIGHER_HIGH_DEFAULT }
+};
+#define EEPROMCW_BANDFIELDSTOT (sizeof(eepromcw_bandfields)/sizeof(eepromitem_fieldt))
+#endif
+
+#if FLOWRATE_ENABLED == 1
+//flow rate fields validation table
+const eepromitem_fieldt eepromflow_fields[] PROGMEM = {
+	{ offsetof(eepromflow_eet, enabled), EEPROMITEM_TYPEUINT8, FLOWRATE_ENABLED_MIN, FLOWRATE_ENABLED_MAX, FLOWRATE_ENABLED_DEFAULT },
+	{ offsetof(eepromflow_eet, low), EEPROMITEM_TYPEUINT16, FLOWRATE_BAND_MIN, FLOWRATE_BAND_MAX, FLOWRATE_LOW_DEFAULT },
+	{ offsetof(eepromflow_eet, high), EEPROMITEM_TYPEUINT16, FLOWRATE_BAND_MIN, FLOWRATE_BAND_MAX, FLOWRATE_HIGH_DEFAULT },
+	{ offsetof(eepromflow_eet, refill), EEPROMITEM_TYPEUINT16, FLOWRATE_REFILL_MIN, FLOWRATE_REFILL_MAX, FLOWRATE_REFILL_DEFAULT }
+};
+#define EEPROMFLOW_FIELDSTOT (sizeof(eepromflow_fields)/sizeof(eepromitem_fieldt))
+#endif
+
+#if KALMAN_ENABLED == 1
+//kalman filter fields validation table
+const eepromitem_fieldt eepromkf_fields[] PROGMEM = {
+	{ offsetof(eepromkf_eet, noise), EEPROMITEM_TYPEUINT16, KALMAN_NOISE_MIN, KALMAN_NOISE_MAX, KALMAN_NOISE_DEFAULT },
+	{ offsetof(eepromkf_eet, process), EEPROMITEM_TYPEUINT16, KALMAN_PROCESS_MIN, KALMAN_PROCESS_MAX, KALMAN_PROCESS_DEFAULT }
+};
+#define EEPROMKF_FIELDSTOT (sizeof(eepromkf_fields)/sizeof(eepromitem_fieldt))
+#endif
+
+
+/*
+ * validate a set of fields, fields out of range or not stored take the default value
+ * return the number of fields set to default
+ */
+uint8_t eepromitem_validatefields(const eepromitem_fieldt *fields, uint8_t fieldstot, uint8_t *base, int16_t len) {
+	uint8_t i = 0;
+	uint8_t ret = 0;
+	for(i=0; i<fieldstot; i++) {
+		eepromitem_fieldt field;
+		memcpy_P(&field, &fields[i], sizeof(eepromitem_fieldt));
+		uint8_t *p = base + field.offset;
+		int32_t value = 0;
+		uint8_t valid = 1;
+		if(field.type == EEPROMITEM_TYPEUINT8) {
+			value = *p;
+		} else if(field.type == EEPROMITEM_TYPEUINT16) {
+			value = *(uint16_t *)p;
+		} else if(field.type == EEPROMITEM_TYPEINT16) {
+			value = *(int16_t *)p;
+		} else if(field.type == EEPROMITEM_TYPEINT32) {
+			value = *(int32_t *)p;
+		} else if(field.type == EEPROMITEM_TYPEDOUBLE) {
+			double d = *(double *)p;
+			if(isnan(d) || isinf(d) || d == 0)
+				valid = 0;
+		}
+		if(field.type != EEPROMITEM_TYPEDOUBLE && (value < field.min || value > field.max))
+			valid = 0;
+		//field not stored by an older layout
+		if(field.offset >= len)
+			valid = 0;
+
+		//set default
+		if(!valid) {
+			if(field.type == EEPROMITEM_TYPEUINT8)
+				*p = field.def;
+			else if(field.type == EEPROMITEM_TYPEUINT16 || field.type == EEPROMITEM_TYPEINT16)
+				*(int16_t *)p = field.def;
+			else if(field.type == EEPROMITEM_TYPEINT32)
+				*(int32_t *)p = field.def;
+			else if(field.type == EEPROMITEM_TYPEDOUBLE)
+				*(double *)p = field.def;
+			ret++;
+		}
+	}
+	return ret;
+}
+
+
+/*
+ * validate indwgtcheck eeprom, return the number of fields set to default
+ */
+uint8_t eepromitem_eepromvalidate(uint8_t len) {
+	uint8_t i = 0;
+	uint8_t ret = 0;
+	ret += eepromitem_validatefields(eepromitem_fields, EEPROMITEM_FIELDSTOT, (uint8_t *)&eepromitem_eevar, len);
+	for(i=0; i<RECIPE_TOT; i++)
+		ret += eepromitem_validatefields(eepromitem_recipefields, EEPROMITEM_RECIPEFIELDSTOT, (uint8_t *)&eepromitem_eevar.recipes[i], (int16_t)len - offsetof(eepromitem_eet, recipes[i]));
+	//the gain is a channel A gain
+	if(eepromitem_eevar.weightcal_gain != HX711_GAINCHANNELA128 && eepromitem_eevar.weightcal_gain != HX711_GAINCHANNELA64) {
+		eepromitem_eevar.weightcal_gain = WEIGHTCAL_GAIN_DEFAULT;
+		ret++;
+	}
+	return ret;
+}
 
 
 /*
  * init indwgtcheck eeprom
  */
 void eepromitem_eeprominit() {
-	eepromitem_eevar.initeeprom = 1;
-	eepromitem_eevar.getweight_interval = GETWEIGHT_INTERVAL_DEFAULT;
-	eepromitem_eevar.getweight_thresholderr = GETWEIGHT_THRESHOLDERR_DEFAULT;
-	eepromitem_eevar.getweight_thresholddiff = GETWEIGHT_THRESHOLDDIFF_DEFAULT;
-	eepromitem_eevar.alert_enabled = ALERT_ENABLED_DEFAULT;
-	eepromitem_eevar.skip_interval = SKIP_INTERVAL_DEFAULT;
-	eepromitem_eevar.skip_time = SKIP_TIME_DEFAULT;
-	eepromitem_eevar.weightcal_weight = WEIGHTCAL_WEIGHT_DEFAULT;
-	eepromitem_eevar.weightcal_offset = WEIGHTCAL_OFFSET_DEFAULT;
-	eepromitem_eevar.weightcal_gain = WEIGHTCAL_GAIN_DEFAULT;
-	eepromitem_eevar.weightcal_scale = WEIGHTCAL_SCALE_DEFAULT;
-	eeprom_write_block((const void*)&eepromitem_eevar, (void*)&eepromitem_eemem, sizeof(eepromitem_eet));
+	memset(&eepromitem_eevar, 0, sizeof(eepromitem_eet));
+	eepromitem_eevar.version = EEPROMITEM_VERSION;
+	eepromitem_eepromvalidate(0);
+}
+
+
+/*
+ * migrate layout 1, it has the same fields of layout 2 but no journal
+ */
+void eepromitem_eeprommigratev1() {
+	eepromitem_eevar.version = 2;
+}
+
+
+/*
+ * migrate layout 2, every recipe starts with the configured parameters
+ * return the migrated length
+ */
+uint8_t eepromitem_eeprommigratev2() {
+	uint8_t i = 0;
+	eepromitem_eevar.recipe = 0;
+	for(i=0; i<RECIPE_TOT; i++) {
+		eepromitem_eevar.recipes[i].getweight_interval = eepromitem_eevar.getweight_interval;
+		eepromitem_eevar.recipes[i].getweight_thresholderr = eepromitem_eevar.getweight_thresholderr;
+		eepromitem_eevar.recipes[i].getweight_thresholddiff = eepromitem_eevar.getweight_thresholddiff;
+		eepromitem_eevar.recipes[i].skip_interval = eepromitem_eevar.skip_interval;
+		eepromitem_eevar.recipes[i].skip_time = eepromitem_eevar.skip_time;
+	}
+	eepromitem_eevar.version = 3;
+	return sizeof(eepromitem_eet);
+}
+
+
+/*
+ * read indwgtcheck eeprom, return the number of fields set to default
+ */
+uint8_t eepromitem_eepromread() {
+	//load the newest journal record
+	uint8_t len = eeconf_read(EECONF_CONF, (void*)&eepromitem_eevar, sizeof(eepromitem_eet));
+
+	//load the legacy block
+	if(len == 0) {
+		eeprom_read_block((void*)&eepromitem_eevar, (const void*)eepromitem_eemem, EEPROMITEM_V1SIZE);
+		if(eepromitem_eevar.version == 0xFF) {
+			//not initialized
+			eepromitem_eeprominit();
+			return EEPROMITEM_FIELDSTOT;
+		}
+		len = EEPROMITEM_V1SIZE;
+	}
+
+	//migrate older layouts
+	if(eepromitem_eevar.version == 1)
+		eepromitem_eeprommigratev1();
+	if(eepromitem_eevar.version == 2)
+		len = eepromitem_eeprommigratev2();
+	if(eepromitem_eevar.version != EEPROMITEM_VERSION) {
+		//unknown layout
+		eepromitem_eeprominit();
+		return EEPROMITEM_FIELDSTOT;
+	}
+
+	//validate
+	return eepromitem_eepromvalidate(len);
+}
+
+
+/*
+ * compute the runtime parameters of a recipe
+ */
+void runtime_compute(uint8_t recipe) {
+	const recipe_eet *r = &eepromitem_eevar.recipes[recipe];
+	runtime_t *rt = &runtime_recipes[recipe];
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		rt->getweight_interval = r->getweight_interval;
+		rt->getweight_thresholderr = r->getweight_thresholderr;
+		rt->getweight_thresholddiff = (double)r->getweight_thresholddiff/1000.0;
+		rt->skip_interval = (uint32_t)r->skip_interval * 60;
+		rt->skip_time = (uint32_t)r->skip_time * 60;
+	}
+}
+
+
+/*
+ * load a recipe to the working parameters and switch the runtime parameters
+ */
+void recipe_load(uint8_t recipe) {
+	const recipe_eet *r = &eepromitem_eevar.recipes[recipe];
+	eepromitem_eevar.recipe = recipe;
+	eepromitem_eevar.getweight_interval = r->getweight_interval;
+	eepromitem_eevar.getweight_thresholderr = r->getweight_thresholderr;
+	eepromitem_eevar.getweight_thresholddiff = r->getweight_thresholddiff;
+	eepromitem_eevar.skip_interval = r->skip_interval;
+	eepromitem_eevar.skip_time = r->skip_time;
+	//the timer interrupt reads the runtime parameters
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		runtime = &runtime_recipes[recipe];
+	}
+}
+
+
+/*
+ * store the working parameters to the active recipe
+ */
+void recipe_store() {
+	recipe_eet *r = &eepromitem_eevar.recipes[eepromitem_eevar.recipe];
+	r->getweight_interval = eepromitem_eevar.getweight_interval;
+	r->getweight_thresholderr = eepromitem_eevar.getweight_thresholderr;
+	r->getweight_thresholddiff = eepromitem_eevar.getweight_thresholddiff;
+	r->skip_interval = eepromitem_eevar.skip_interval;
+	r->skip_time = eepromitem_eevar.skip_time;
+	runtime_compute(eepromitem_eevar.recipe);
+}
+
+
+/*
+ * read calibration table eeprom and set the table
+ */
+void eepromcal_eepromread() {
+	if(eeconf_read(EECONF_CAL, (void*)&eepromcal_eevar, sizeof(eepromcal_eet)) != sizeof(eepromcal_eet) || eepromcal_eevar.count > LINCAL_POINTSMAX)
+		eepromcal_eevar.count = 0;
+	lincal_setpoints(eepromcal_eevar.points, eepromcal_eevar.count);
+}
+
+
+#if CHECKWEIGHER_ENABLED == 1
+/*
+ * raise the reject delay past the capture window, the reject time must not be
+ * already gone when the item is classified, return 1 if the delay is changed
+ */
+uint8_t eepromcw_clampdelay() {
+	uint16_t delay = eepromcw_eevar.window + REJECT_DELAY_MARGIN;
+	if(eepromcw_eevar.reject_delay >= delay)
+		return 0;
+	eepromcw_eevar.reject_delay = delay;
+	return 1;
+}
+
+
+/*
+ * read checkweigher eeprom, return the number of fields set to default
+ */
+uint8_t eepromcw_eepromread() {
+	uint8_t i = 0;
+	uint8_t ret = 0;
+	uint8_t len = eeconf_read(EECONF_CW, (void*)&eepromcw_eevar, sizeof(eepromcw_eet));
+	ret += eepromitem_validatefields(eepromcw_fields, EEPROMCW_FIELDSTOT, (uint8_t *)&eepromcw_eevar, len);
+	for(i=0; i<RECIPE_TOT; i++)
+		ret += eepromitem_validatefields(eepromcw_bandfields, EEPROMCW_BANDFIELDSTOT, (uint8_t *)&eepromcw_eevar.bands[i], (int16_t)len - offsetof(eepromcw_eet, bands[i]));
+	ret += eepromcw_clampdelay();
+	return ret;
+}
+#endif
+
+
+#if PRODSTATS_ENABLED == 1
+/*
+ * read production statistics snapshot eeprom and restore the statistics
+ */
+void eepromstats_eepromread() {
+	uint8_t i = 0;
+	memset(&prodstats, 0, sizeof(prodstats_t));
+	if(eeconf_read(EECONF_STATS, (void*)&eepromstats_eevar, sizeof(eepromstats_eet)) != sizeof(eepromstats_eet))
+		return;
+	stats_set(&prodstats.weight, eepromstats_eevar.n, eepromstats_eevar.weight.mean, eepromstats_eevar.weight.variance, eepromstats_eevar.weight.min, eepromstats_eevar.weight.max);
+	stats_set(&prodstats.diff, eepromstats_eevar.n, eepromstats_eevar.diff.mean, eepromstats_eevar.diff.variance, eepromstats_eevar.diff.min, eepromstats_eevar.diff.max);
+	prodstats.alarms = eepromstats_eevar.alarms;
+	for(i=0; i<PRODSTATS_HISTBINS; i++)
+		prodstats.histogram[i] = (uint16_t)eepromstats_eevar.histogram[i] << eepromstats_eevar.histogramshift;
+}
+#endif
+
+
+#if FLOWRATE_ENABLED == 1
+/*
+ * read flow rate eeprom, return the number of fields set to default
+ */
+uint8_t eepromflow_eepromread() {
+	uint8_t len = eeconf_read(EECONF_FLOW, (void*)&eepromflow_eevar, sizeof(eepromflow_eet));
+	return eepromitem_validatefields(eepromflow_fields, EEPROMFLOW_FIELDSTOT, (uint8_t *)&eepromflow_eevar, len);
+}
+#endif
+
+
+#if KALMAN_ENABLED == 1
+/*
+ * read kalman filter eeprom, return the number of fields set to default
+ */
+uint8_t eepromkf_eepromread() {
+	uint8_t len = eeconf_read(EECONF_KF, (void*)&eepromkf_eevar, sizeof(eepromkf_eet));
+	return eepromitem_validatefields(eepromkf_fields, EEPROMKF_FIELDSTOT, (uint8_t *)&eepromkf_eevar, len);
 }
+#endif
 
 
 /*
- * read indwgtcheck eeprom
+ * process the pending eeprom writes, the journals write in background
  */
-void eepromitem_eepromread() {
-	eeprom_read_block((void*)&eepromitem_eevar, (const void*)&eepromitem_eemem, sizeof(eepromitem_eet));
+void eepromitem_eepromprocess() {
+	if((eepromitem_writepending & (1<<EECONF_CONF)) && eeconf_write(EECONF_CONF, (const void*)&eepromitem_eevar, sizeof(eepromitem_eet)) != EECONF_WRITEBUSY)
+		eepromitem_writepending &= ~(1<<EECONF_CONF);
+	if((eepromitem_writepending & (1<<EECONF_CAL)) && eeconf_write(EECONF_CAL, (const void*)&eepromcal_eevar, sizeof(eepromcal_eet)) != EECONF_WRITEBUSY)
+		eepromitem_writepending &= ~(1<<EECONF_CAL);
+#if CHECKWEIGHER_ENABLED == 1
+	if((eepromitem_writepending & (1<<EECONF_CW)) && eeconf_write(EECONF_CW, (const void*)&eepromcw_eevar, sizeof(eepromcw_eet)) != EECONF_WRITEBUSY)
+		eepromitem_writepending &= ~(1<<EECONF_CW);
+#endif
+#if PRODSTATS_ENABLED == 1
+	if((eepromitem_writepending & (1<<EECONF_STATS)) && eeconf_write(EECONF_STATS, (const void*)&eepromstats_eevar, sizeof(eepromstats_eet)) != EECONF_WRITEBUSY)
+		eepromitem_writepending &= ~(1<<EECONF_STATS);
+#endif
+#if FLOWRATE_ENABLED == 1
+	if((eepromitem_writepending & (1<<EECONF_FLOW)) && eeconf_write(EECONF_FLOW, (const void*)&eepromflow_eevar, sizeof(eepromflow_eet)) != EECONF_WRITEBUSY)
+		eepromitem_writepending &= ~(1<<EECONF_FLOW);
+#endif
+#if KALMAN_ENABLED == 1
+	if((eepromitem_writepending & (1<<EECONF_KF)) && eeconf_write(EECONF_KF, (const void*)&eepromkf_eevar, sizeof(eepromkf_eet)) != EECONF_WRITEBUSY)
+		eepromitem_writepending &= ~(1<<EECONF_KF);
+#endif
 }
 
 
@@ -81,8 +651,256 @@ void eepromitem_eepromread() {
  * write indwgtcheck eeprom
  */
 void eepromitem_eepromwrite() {
-	eeprom_write_block((const void*)&eepromitem_eevar, (void*)&eepromitem_eemem, sizeof(eepromitem_eet));
+	eepromitem_writepending |= (1<<EECONF_CONF);
+	eepromitem_eepromprocess();
+}
+
+
+/*
+ * write calibration table eeprom
+ */
+void eepromcal_eepromwrite() {
+	eepromitem_writepending |= (1<<EECONF_CAL);
+	eepromitem_eepromprocess();
+}
+
+
+#if CHECKWEIGHER_ENABLED == 1
+/*
+ * write checkweigher eeprom
+ */
+void eepromcw_eepromwrite() {
+	eepromitem_writepending |= (1<<EECONF_CW);
+	eepromitem_eepromprocess();
+}
+#endif
+
+
+#if PRODSTATS_ENABLED == 1
+/*
+ * write a production statistics snapshot eeprom
+ */
+void eepromstats_eepromwrite() {
+	uint8_t i = 0;
+	uint16_t max = 0;
+	eepromstats_eevar.n = prodstats.weight.n;
+	eepromstats_eevar.alarms = prodstats.alarms;
+	eepromstats_eevar.weight.mean = stats_getmean(&prodstats.weight);
+	eepromstats_eevar.weight.variance = stats_getvariance(&prodstats.weight);
+	eepromstats_eevar.weight.min = prodstats.weight.min;
+	eepromstats_eevar.weight.max = prodstats.weight.max;
+	eepromstats_eevar.diff.mean = stats_getmean(&prodstats.diff);
+	eepromstats_eevar.diff.variance = stats_getvariance(&prodstats.diff);
+	eepromstats_eevar.diff.min = prodstats.diff.min;
+	eepromstats_eevar.diff.max = prodstats.diff.max;
+	//histogram in 8 bits, scaled on the largest bin
+	for(i=0; i<PRODSTATS_HISTBINS; i++) {
+		if(prodstats.histogram[i] > max)
+			max = prodstats.histogram[i];
+	}
+	eepromstats_eevar.histogramshift = 0;
+	while((max >> eepromstats_eevar.histogramshift) > 0xFF)
+		eepromstats_eevar.histogramshift++;
+	for(i=0; i<PRODSTATS_HISTBINS; i++)
+		eepromstats_eevar.histogram[i] = prodstats.histogram[i] >> eepromstats_eevar.histogramshift;
+	eepromitem_writepending |= (1<<EECONF_STATS);
+	eepromitem_eepromprocess();
+}
+#endif
+
+
+#if FLOWRATE_ENABLED == 1
+/*
+ * write flow rate eeprom
+ */
+void eepromflow_eepromwrite() {
+	eepromitem_writepending |= (1<<EECONF_FLOW);
+	eepromitem_eepromprocess();
+}
+#endif
+
+
+#if KALMAN_ENABLED == 1
+/*
+ * write kalman filter eeprom
+ */
+void eepromkf_eepromwrite() {
+	eepromitem_writepending |= (1<<EECONF_KF);
+	eepromitem_eepromprocess();
+}
+#endif
+
+
+/*
+ * convert a tared raw value to weight, using the calibration table if it is set
+ */
+double weight_convert(double raw) {
+	if(lincal_getsegments())
+		return (double)lincal_convert((int32_t)raw)/(1L<<LINCAL_WEIGHTSHIFT);
+	return raw/hx711_getscale();
+}
+
+
+/*
+ * record a filtered tared sample (raw units), one for each weight reading,
+ * checkweigher item or flow rate second
+ */
+void weight_sample(int32_t raw) {
+	weight_lastraw = raw;
+#if HISTORY_ENABLED == 1
+	history_add(raw);
+#endif
+}
+
+
+/*
+ * get the weight
+ */
+double weight_get() {
+	double raw = hx711_readwithtare();
+	weight_sample((int32_t)raw);
+	return weight_convert(raw);
+}
+
+#if KALMAN_ENABLED == 1
+/*
+ * set the kalman filter noises from the weight units settings and restart it
+ */
+void weight_kalmaninit() {
+	double sps = 1000000.0/hx711_getperiod();
+	double r = eepromkf_eevar.noise/1000.0*hx711_getscale();
+	//rate noise for each sample, the variance grows linearly in time
+	double q = eepromkf_eevar.process/1000.0*hx711_getscale()/sps;
+	kalman_init(q*q/sps, r*r);
+	weight_kalmansps = (uint8_t)lround(sps);
+	weight_kalmanperiod = hx711_getperiod();
+}
+
+/*
+ * get the weight change of the filtered rate over seconds
+ */
+double weight_getchange(uint8_t seconds) {
+	double samples = (double)weight_kalmansps*seconds;
+	int32_t mass = kalman_getmass();
+	return weight_convert(mass + kalman_getrate()*samples) - weight_convert(mass);
+}
+
+/*
+ * filter a conversion
+ */
+void weight_kalmansample() {
+	int32_t raw = hx711_read() - hx711_getoffset();
+	//the background measure changed the period
+	if(hx711_getperiod() != weight_kalmanperiod)
+		weight_kalmaninit();
+	kalman_update(raw);
+	if(weight_kalmansamples < 0xFF)
+		weight_kalmansamples++;
+}
+#endif
+
+
+#if WARMSTART_ENABLED == 1
+/*
+ * compute the warm restart state crc
+ */
+uint16_t warmstart_crc() {
+	uint16_t crc = 0xFFFF;
+	uint8_t i = 0;
+	for(i=0; i<offsetof(warmstart_t, crc); i++)
+		crc = _crc16_update(crc, ((uint8_t *)&warmstart)[i]);
+	return crc;
+}
+
+
+/*
+ * save the warm restart state
+ */
+void warmstart_save(double weight_previous, uint8_t initweight_previous, uint8_t weight_errors) {
+	//the skip state is updated by the timer interrupt
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		warmstart.error_state = error_state;
+		warmstart.skip_state = skip_state;
+		warmstart.skip_intervalcounter = skip_intervalcounter;
+		warmstart.skip_timecounter = skip_timecounter;
+	}
+	warmstart.weight_previous = weight_previous;
+	warmstart.initweight_previous = initweight_previous;
+	warmstart.weight_errors = weight_errors;
+	warmstart.crc = warmstart_crc();
+}
+
+
+/*
+ * count the reset and restore the running state, return 1 on a warm restart
+ * resetcause is the MCUCSR value
+ */
+uint8_t warmstart_restore(uint8_t resetcause) {
+	uint8_t ret = 0;
+
+	//the state is garbage after a power on, or if the reset broke a save
+	if((resetcause & (1<<PORF)) || warmstart.crc != warmstart_crc()) {
+		memset(&warmstart, 0, sizeof(warmstart_t));
+	} else if(resetcause & ((1<<WDRF) | (1<<BORF))) {
+		error_state = warmstart.error_state;
+		skip_state = warmstart.skip_state;
+		skip_intervalcounter = warmstart.skip_intervalcounter;
+		skip_timecounter = warmstart.skip_timecounter;
+		ret = 1;
+	}
+
+	//count the reset
+	if((resetcause & (1<<WDRF)) && warmstart.resets_wdt < 0xFFFF)
+		warmstart.resets_wdt++;
+	if((resetcause & (1<<BORF)) && warmstart.resets_bor < 0xFFFF)
+		warmstart.resets_bor++;
+
+	//a cold start does not resume the weight check
+	if(!ret) {
+		warmstart.initweight_previous = 1;
+		warmstart.weight_errors = 0;
+	}
+	warmstart.crc = warmstart_crc();
+
+	return ret;
 }
+#endif
+
+
+#if EVENTLOG_ENABLED == 1
+/*
+ * log an event with the last raw weight
+ */
+void eventlog_log(uint8_t type, double diff, uint8_t errors) {
+	eventlog_eventt e;
+	e.type = type;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		e.time = uptime_seconds;
+	}
+	e.raw = weight_lastraw;
+	e.diff = (int16_t)lround(fmax(fmin(diff*1000, INT16_MAX), INT16_MIN));
+	e.errors = errors;
+	eventlog_add(&e);
+}
+
+
+/*
+ * print the event type
+ */
+void eventlog_lcdputtype(uint8_t type) {
+	if(type == EVENTLOG_TYPERESET)
+		lcd_puts_p(PSTR("Reset"));
+	else if(type == EVENTLOG_TYPEALARM)
+		lcd_puts_p(PSTR("Alarm"));
+	else if(type == EVENTLOG_TYPEALARMCLEAR)
+		lcd_puts_p(PSTR("Clear"));
+	else if(type == EVENTLOG_TYPESKIP)
+		lcd_puts_p(PSTR("Skip"));
+	else if(type == EVENTLOG_TYPEFAULT)
+		lcd_puts_p(PSTR("Fault"));
+}
+#endif
 
 
 /**
@@ -91,6 +909,24 @@ void eepromitem_eepromwrite() {
 MAINTIMER_INTERRUPT {
 	static uint16_t key_10msstepcounter = 0;
 	static uint16_t counter_1000msstepcounter = 0;
+#if RECIPE_INPUTENABLED == 1
+	static uint8_t recipe_inputlast = 0;
+	static uint8_t recipe_inputcount = 0;
+#endif
+
+	DIAG_ISRSTART(isrstart)
+
+	//timebase
+	maintimer_steps++;
+
+#if CHECKWEIGHER_ENABLED == 1
+	//reject pulses
+	uint8_t reject_edge = reject_timerinterrupt(maintimer_steps);
+	if(reject_edge == REJECT_PULSESTART)
+		RELALERT_ON;
+	else if(reject_edge == REJECT_PULSEEND)
+		RELALERT_OFF;
+#endif
 
 	if(key_enabled) {
 		key_10msstepcounter++;
@@ -99,6 +935,19 @@ MAINTIMER_INTERRUPT {
 			key_10msstepcounter = 0;
 			//key interrupt
 			key_timerinterrupt();
+
+#if RECIPE_INPUTENABLED == 1
+			//debounce the recipe input
+			uint8_t recipe_inputnow = (~RECIPE_INPUTPIN >> RECIPE_INPUTPINNUM) & RECIPE_INPUTMASK;
+			if(recipe_inputnow != recipe_inputlast) {
+				recipe_inputlast = recipe_inputnow;
+				recipe_inputcount = 0;
+			} else if(recipe_inputcount < RECIPE_INPUTDEBOUNCE) {
+				recipe_inputcount++;
+				if(recipe_inputcount == RECIPE_INPUTDEBOUNCE)
+					recipe_input = recipe_inputnow;
+			}
+#endif
 		}
 	}
 
@@ -108,17 +957,28 @@ MAINTIMER_INTERRUPT {
 		counter_1000msstepcounter = 0;
 
 		//trigger a get weight event
+#if DIAG_ENABLED == 1
+		if(getweighttrigger && currentstate == running && !skip_state) {
+			//previous event not served yet by the weight check
+			DIAG_SAMPLEDROPPED
+		}
+#endif
 		getweighttrigger = 1;
 
 		//one seconds trigger
 		onesectrigger = 1;
 
+#if EVENTLOG_ENABLED == 1
+		//uptime
+		uptime_seconds++;
+#endif
+
 		//skip counter
-		if(eepromitem_eevar.skip_interval != 0 && !error_state && currentstate == running) {
+		if(runtime->skip_interval != 0 && !error_state && currentstate == running) {
 			if(skip_state) {
 				//count time in skipping mode
 				skip_timecounter++;
-				if(skip_timecounter >= eepromitem_eevar.skip_time * 60) {
+				if(skip_timecounter >= runtime->skip_time) {
 					skip_timecounter = 0;
 					skip_state = 0;
 
@@ -128,7 +988,7 @@ MAINTIMER_INTERRUPT {
 			} else {
 				//count time to skip mode
 				skip_intervalcounter++;
-				if(skip_intervalcounter >= eepromitem_eevar.skip_interval * 60) {
+				if(skip_intervalcounter >= runtime->skip_interval) {
 					skip_intervalcounter = 0;
 					skip_state = 1;
 
@@ -138,7 +998,39 @@ MAINTIMER_INTERRUPT {
 			}
 		}
 	}
+
+	DIAG_ISRSTOP(isrstart)
+}
+
+/*
+ * get the main timer time (us), steps and counter, wraps every 71 minutes
+ */
+uint32_t maintimer_getus() {
+	uint32_t steps = 0;
+	uint8_t count = 0;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		steps = maintimer_steps;
+		count = TCNT0;
+		//overflow pending but not yet served
+		if((TIFR & (1<<TOV0)) && count < 0x80)
+			steps++;
+	}
+	return (steps*256 + count)*MAINTIMER_TICKUS;
+}
+
+#if CHECKWEIGHER_ENABLED == 1
+/**
+ * checkweigher trigger interrupt, timestamp the item
+ */
+CHECKWEIGHER_TRIGGERINTERRUPT {
+	//ignore the bounces of the last trigger
+	if(maintimer_steps - checkweigher_triggerstep < checkweigher_lockout)
+		return;
+	checkweigher_triggerstep = maintimer_steps;
+	checkweigher_triggered = 1;
 }
+#endif
 
 /*
  * print a number
@@ -160,78 +1052,684 @@ void lcd_writedouble(double n, uint8_t width, uint8_t prec) {
 	lcd_puts(tnum);
 }
 
+#if DIAG_ENABLED == 1
+/*
+ * print a diagnostics page
+ */
+void diag_lcdprint(uint8_t page) {
+	diag_t d;
+	diag_get(&d);
+
+	lcd_gotoxy(0, 0);
+	if(page == DIAGPAGE_LOOP) {
+		lcd_puts_p(PSTR("Loop max/avg us"));
+		lcd_gotoxy(0, 1);
+		lcd_writelong(DIAG_CYCLES2US(d.loopmax));
+		lcd_gotoxy(8, 1);
+		lcd_writelong(DIAG_CYCLES2US(d.loopavg));
+	} else if(page == DIAGPAGE_HX711) {
+		lcd_puts_p(PSTR("HX711 max us"));
+		lcd_gotoxy(0, 1);
+		lcd_writelong(DIAG_CYCLES2US(d.hx711max));
+	} else if(page == DIAGPAGE_LCD) {
+		lcd_puts_p(PSTR("LCD last/max us"));
+		lcd_gotoxy(0, 1);
+		lcd_writelong(DIAG_CYCLES2US(d.lcdlast));
+		lcd_gotoxy(8, 1);
+		lcd_writelong(DIAG_CYCLES2US(d.lcdmax));
+	} else if(page == DIAGPAGE_ISR) {
+		lcd_puts_p(PSTR("ISR us / Dropped"));
+		lcd_gotoxy(0, 1);
+		lcd_writelong(DIAG_CYCLES2US(d.isrmax));
+		lcd_gotoxy(8, 1);
+		lcd_writelong(d.samplesdropped);
+	} else if(page == DIAGPAGE_WDT) {
+		lcd_puts_p(PSTR("WDT margin ms"));
+		lcd_gotoxy(0, 1);
+		lcd_writelong(DIAG_CYCLES2US(diag_getwdtmargin())/1000);
+	} else if(page == DIAGPAGE_RAM) {
+		lcd_puts_p(PSTR("RAM data/bss"));
+		lcd_gotoxy(0, 1);
+		lcd_writelong(diag_getdatasize());
+		lcd_gotoxy(8, 1);
+		lcd_writelong(diag_getbsssize());
+	} else if(page == DIAGPAGE_STACK) {
+		uint16_t stackfree = diag_getstackfree();
+		lcd_puts_p(PSTR("Stack max/free"));
+		lcd_gotoxy(0, 1);
+		lcd_writelong(diag_getstacksize() - stackfree);
+		lcd_gotoxy(8, 1);
+		lcd_writelong(stackfree);
+	}
+#if WARMSTART_ENABLED == 1
+	else if(page == DIAGPAGE_RESETS) {
+		lcd_puts_p(PSTR("Resets WDT/BOR"));
+		lcd_gotoxy(0, 1);
+		lcd_writelong(warmstart.resets_wdt);
+		lcd_gotoxy(8, 1);
+		lcd_writelong(warmstart.resets_bor);
+	}
+#endif
+}
+#endif
+
+#if TELEMETRY_ENABLED == 1
+/*
+ * send a telemetry field
+ */
+void telemetry_putfield(const char *progmem_name, int32_t value) {
+	uart_puts_p(progmem_name);
+	uart_putc('=');
+	uart_putlong(value);
+	uart_putc(' ');
+}
+
 /*
- * fast set a number
- */
-int32_t set_plusminus(int32_t n, int32_t max, int32_t min) {
-	int32_t ret = n;
-	static uint16_t buttons_rptUP = 0;
-	static uint16_t buttons_rptDOWN = 0;
-
-	if(key_getpress(1<<BUTTON_UP) && n < max) {
-		buttons_rptUP = 0;
-		ret += 1;
-	}
-	if(key_getpress(1<<BUTTON_DOWN) && n > min) {
-		buttons_rptDOWN = 0;
-		ret -= 1;
-	}
-
-	if(key_getrpt(1<<BUTTON_UP)) {
-		if(buttons_rptUP < 100) {
-			buttons_rptUP++;
-			if(n < max)
-				ret += 1;
-			else
-				buttons_rptUP = 0;
-		} else if(buttons_rptUP < 1000) {
-			buttons_rptUP+=10;
-			if(n+(100-1) < max)
-				ret += 100;
-			else
-				buttons_rptUP = 0;
-		} else {
-			if(n+(1000-1) < max)
-				ret += 1000;
-			else
-				buttons_rptUP = 100;
+ * process telemetry commands
+ */
+void telemetry_process() {
+#if EVENTLOG_ENABLED == 1
+	//send the event log one record at a time, a record under a background write
+	//is sent by the next calls
+	if(telemetry_eventlogindex != 0xFF) {
+		eventlog_eventt e;
+		if(telemetry_eventlogindex >= eventlog_getcount()) {
+			telemetry_eventlogindex = 0xFF;
+		} else if(eventlog_get(telemetry_eventlogindex, &e)) {
+			telemetry_putfield(PSTR("event"), telemetry_eventlogindex);
+			telemetry_putfield(PSTR("type"), e.type);
+			telemetry_putfield(PSTR("time"), e.time);
+			telemetry_putfield(PSTR("raw"), e.raw);
+			telemetry_putfield(PSTR("diff"), e.diff);
+			telemetry_putfield(PSTR("errors"), e.errors);
+			uart_puts_p(PSTR("\r\n"));
+			telemetry_eventlogindex++;
+		}
+		return;
+	}
+#endif
+
+	int16_t c = uart_getc();
+	if(c == -1)
+		return;
+
+#if DIAG_ENABLED == 1
+	if(c == TELEMETRY_CMDDIAG) {
+		//send diagnostics, times in us
+		diag_t d;
+		diag_get(&d);
+		telemetry_putfield(PSTR("loopmax"), DIAG_CYCLES2US(d.loopmax));
+		telemetry_putfield(PSTR("loopavg"), DIAG_CYCLES2US(d.loopavg));
+		telemetry_putfield(PSTR("hx711max"), DIAG_CYCLES2US(d.hx711max));
+		telemetry_putfield(PSTR("lcdlast"), DIAG_CYCLES2US(d.lcdlast));
+		telemetry_putfield(PSTR("lcdmax"), DIAG_CYCLES2US(d.lcdmax));
+		telemetry_putfield(PSTR("isrmax"), DIAG_CYCLES2US(d.isrmax));
+		telemetry_putfield(PSTR("dropped"), d.samplesdropped);
+		telemetry_putfield(PSTR("wdtmargin"), DIAG_CYCLES2US(diag_getwdtmargin()));
+		telemetry_putfield(PSTR("hx711period"), hx711_getperiod());
+		//send ram usage, sizes in bytes
+		uint16_t stackfree = diag_getstackfree();
+		telemetry_putfield(PSTR("data"), diag_getdatasize());
+		telemetry_putfield(PSTR("bss"), diag_getbsssize());
+		telemetry_putfield(PSTR("stackmax"), diag_getstacksize() - stackfree);
+		telemetry_putfield(PSTR("stackfree"), stackfree);
+#if WARMSTART_ENABLED == 1
+		//send reset counters
+		telemetry_putfield(PSTR("resetswdt"), warmstart.resets_wdt);
+		telemetry_putfield(PSTR("resetsbor"), warmstart.resets_bor);
+#endif
+		uart_puts_p(PSTR("\r\n"));
+	}
+#endif
+
+#if HISTORY_ENABLED == 1
+	if(c == TELEMETRY_CMDHISTORY) {
+		//send the sample history, header and encoded bytes in hex
+		uint8_t i = 0;
+		telemetry_putfield(PSTR("count"), history_getcount());
+		telemetry_putfield(PSTR("pre"), history_getpre());
+		telemetry_putfield(PSTR("first"), history_getfirst());
+		telemetry_putfield(PSTR("len"), history_getlen());
+		uart_puts_p(PSTR("\r\n"));
+		for(i=0; i<history_getlen(); i++) {
+			uint8_t b = history_getbyte(i);
+			uart_putc("0123456789ABCDEF"[b>>4]);
+			uart_putc("0123456789ABCDEF"[b&0x0F]);
+			if((i & 0x1F) == 0x1F || i == history_getlen()-1)
+				uart_puts_p(PSTR("\r\n"));
 		}
 	}
+#endif
+
+#if EVENTLOG_ENABLED == 1
+	if(c == TELEMETRY_CMDEVENTLOG) {
+		//start sending the event log, newest first
+		telemetry_eventlogindex = 0;
+	}
+#endif
+}
+#endif
+
+/*
+ * start the calibration sampler
+ */
+void calsampler_start() {
+	stats_reset(&calsampler_stats);
+	calsampler_seconds = 0;
+	onesectrigger = 0;
+	calsampler_running = 1;
+}
 
-	if(key_getrpt(1<<BUTTON_DOWN)) {
-		if(buttons_rptDOWN < 100) {
-			buttons_rptDOWN++;
-			if(n > min)
-				ret -= 1;
-			else
-				buttons_rptDOWN = 0;
-		} else if(buttons_rptDOWN < 1000) {
-			buttons_rptDOWN+=10;
-			if(n-(100) > min)
-				ret -= 100;
-			else
-				buttons_rptDOWN = 0;
-		} else {
-			if(n-(1000) > min)
-				ret -= 1000;
-			else
-				buttons_rptDOWN = 100;
+
+/*
+ * run the calibration sampler without blocking, return 1 when the sampling ends
+ * sampling ends when the standard error of the mean is below the target or at max time
+ */
+uint8_t calsampler_process() {
+	if(!calsampler_running)
+		return 0;
+
+	//count time
+	if(onesectrigger) {
+		onesectrigger = 0;
+		calsampler_seconds++;
+	}
+
+	//read a sample if available
+	if(hx711_isready()) {
+		int32_t raw = hx711_read();
+
+		//restart if the load moves
+		if(calsampler_stats.n && labs(raw - stats_getmean(&calsampler_stats)) > CALSAMPLER_STEPMAX)
+			stats_reset(&calsampler_stats);
+		stats_add(&calsampler_stats, raw);
+
+		//check the standard error, variance/n <= target^2
+		if(calsampler_stats.n >= CALSAMPLER_SAMPLESMIN &&
+				stats_getvariance(&calsampler_stats) <= (double)CALSAMPLER_STDERRTARGET*CALSAMPLER_STDERRTARGET*calsampler_stats.n) {
+			calsampler_running = 0;
+			return 1;
 		}
 	}
 
-	return ret;
+	//check max time
+	if(calsampler_seconds >= CALSAMPLER_TIMEMAX && calsampler_stats.n) {
+		calsampler_running = 0;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/*
+ * print the calibration sampler progress, samples and standard error
+ */
+void calsampler_lcdprint() {
+	lcd_gotoxy(0, 1);
+	lcd_writelong(calsampler_stats.n);
+	lcd_gotoxy(6, 1);
+	lcd_puts_p(PSTR("se"));
+	lcd_writedouble(stats_getstderr(&calsampler_stats), 8, 1);
+}
+
+
+#if CHARACTERIZE_ENABLED == 1
+/*
+ * start the noise characterization
+ */
+void characterize_start() {
+	noise_reset();
+	characterize_seconds = 0;
+	onesectrigger = 0;
+	characterize_running = 1;
+}
+
+
+/*
+ * run the noise characterization without blocking, return 1 when the time ends
+ * intervals are closed at the weighing interval of the working recipe
+ */
+uint8_t characterize_process() {
+	if(!characterize_running)
+		return 0;
+
+	//read a sample if available
+	if(hx711_isready())
+		noise_addsample(hx711_read());
+
+	//count time
+	if(onesectrigger) {
+		onesectrigger = 0;
+		characterize_seconds++;
+		if(characterize_seconds % eepromitem_eevar.getweight_interval == 0)
+			noise_interval();
+		if(characterize_seconds >= characterize_time) {
+			characterize_running = 0;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+
+/*
+ * compute the recommended number of errors and diff threshold (x1000)
+ * an error is counted when the weight diff over the interval is below the threshold,
+ * the threshold is set k sigma below the mean diff of the loaded run, k is chosen
+ * so that num errors consecutive noise errors happen at the target rate.
+ * The number of errors is the smallest that keeps the threshold in the loaded half
+ * of the gap between the unloaded and the loaded mean diff, an unloaded diff then
+ * counts an error at least as likely as a loaded one does not
+ */
+void characterize_recommend() {
+	double diffstddev = characterize_loaded.diffstddev;
+	double halfgap = (characterize_loaded.diffmean - characterize_unloaded.diffmean)/2;
+	double threshold = 0;
+	double k = 0;
+	uint8_t errors = 0;
+
+	if(characterize_unloaded.diffstddev > diffstddev)
+		diffstddev = characterize_unloaded.diffstddev;
+	//too few intervals, assume white noise
+	if(diffstddev == 0)
+		diffstddev = M_SQRT2 * fmax(characterize_unloaded.stddev, characterize_loaded.stddev);
+
+	for(errors=GETWEIGHT_THRESHOLDERR_MIN; errors<=GETWEIGHT_THRESHOLDERR_MAX; errors++) {
+		k = noise_qinv(pow((double)eepromitem_eevar.getweight_interval/(3600.0*CHARACTERIZE_FALSEALARMHOURS), 1.0/errors));
+		if(k*diffstddev <= halfgap)
+			break;
+	}
+	//the runs do not separate, take the most errors
+	if(errors > GETWEIGHT_THRESHOLDERR_MAX)
+		errors = GETWEIGHT_THRESHOLDERR_MAX;
+	characterize_thresholderr = errors;
+	threshold = (characterize_loaded.diffmean - k*diffstddev)/hx711_getscale()*1000;
+
+	if(threshold < GETWEIGHT_THRESHOLDDIFF_MIN)
+		threshold = GETWEIGHT_THRESHOLDDIFF_MIN;
+	if(threshold > GETWEIGHT_THRESHOLDDIFF_MAX)
+		threshold = GETWEIGHT_THRESHOLDDIFF_MAX;
+	characterize_thresholddiff = lround(threshold);
+}
+
+
+/*
+ * print the standard deviation and peak to peak of a run, weight units
+ */
+void characterize_lcdprint(const noise_resultt *r) {
+	lcd_gotoxy(0, 1);
+	lcd_writedouble(r->stddev/hx711_getscale(), 7, 3);
+	lcd_gotoxy(8, 1);
+	lcd_writedouble(r->peaktopeak/hx711_getscale(), 8, 3);
+}
+#endif
+
+
+#if PRODSTATS_ENABLED == 1
+/*
+ * add a weight and a weight diff to the production statistics
+ */
+void prodstats_add(double weight, double diff) {
+	int32_t diff1000 = lround(diff*1000);
+	int32_t bin = 0;
+
+	//counters saturate
+	if(prodstats.weight.n == 0xFFFFFFFF)
+		return;
+	stats_add(&prodstats.weight, lround(weight*1000));
+	stats_add(&prodstats.diff, diff1000);
+
+	//histogram
+	if(diff1000 >= PRODSTATS_HISTMIN)
+		bin = (diff1000 - PRODSTATS_HISTMIN)/PRODSTATS_HISTWIDTH;
+	if(bin > PRODSTATS_HISTBINS-1)
+		bin = PRODSTATS_HISTBINS-1;
+	if(prodstats.histogram[bin] < 0xFFFF)
+		prodstats.histogram[bin]++;
+}
+
+
+/*
+ * print a production statistics page
+ */
+void prodstats_lcdprint(uint8_t page) {
+	const stats_t *s = &prodstats.weight;
+	uint8_t i = 0;
+
+	lcd_gotoxy(0, 0);
+	if(prodstats_saved) {
+		lcd_puts_p(PSTR("Snapshot saved"));
+		return;
+	} else if(page == PRODSTATSPAGE_COUNT) {
+		lcd_puts_p(PSTR("Count     Alarms"));
+		lcd_gotoxy(0, 1);
+		lcd_writelong(prodstats.weight.n);
+		lcd_gotoxy(10, 1);
+		lcd_writedouble(prodstats.alarms, 6, 0);
+		return;
+	} else if(page == PRODSTATSPAGE_HISTOGRAM) {
+		//histogram bars, 0 to 9 scaled on the largest bin
+		uint16_t max = 1;
+		lcd_puts_p(PSTR("Diff Histogram"));
+		for(i=0; i<PRODSTATS_HISTBINS; i++) {
+			if(prodstats.histogram[i] > max)
+				max = prodstats.histogram[i];
+		}
+		lcd_gotoxy(0, 1);
+		for(i=0; i<PRODSTATS_HISTBINS; i++)
+			lcd_putc('0' + (uint8_t)(((uint32_t)prodstats.histogram[i]*9 + max - 1)/max));
+		return;
+	}
+
+	//weight or diff
+	if(page == PRODSTATSPAGE_WEIGHT || page == PRODSTATSPAGE_WEIGHTMINMAX) {
+		lcd_puts_p(PSTR("Wgt "));
+	} else {
+		lcd_puts_p(PSTR("Diff "));
+		s = &prodstats.diff;
+	}
+	if(page == PRODSTATSPAGE_WEIGHT || page == PRODSTATSPAGE_DIFF) {
+		lcd_puts_p(PSTR("Mean/Sd"));
+		lcd_gotoxy(0, 1);
+		lcd_writedouble((double)stats_getmean(s)/1000, 7, 2);
+		lcd_gotoxy(8, 1);
+		lcd_writedouble(stats_getstddev(s)/1000, 8, 3);
+	} else {
+		lcd_puts_p(PSTR("Min/Max"));
+		lcd_gotoxy(0, 1);
+		lcd_writedouble((double)s->min/1000, 7, 2);
+		lcd_gotoxy(8, 1);
+		lcd_writedouble((double)s->max/1000, 8, 2);
+	}
+}
+#endif
+
+
+#if CHECKWEIGHER_ENABLED == 1
+/*
+ * set the trigger lockout from the settle time
+ */
+void checkweigher_setlockout() {
+	uint16_t ms = eepromcw_eevar.settle > CHECKWEIGHER_DEBOUNCE ? eepromcw_eevar.settle : CHECKWEIGHER_DEBOUNCE;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		checkweigher_lockout = MAINTIMER_MS2STEPS(ms);
+	}
+}
+
+
+/*
+ * run the checkweigher capture without blocking, return 1 when an item is weighed
+ * samples read after the settle delay from the trigger timestamp are integrated
+ * until the window ends, a new trigger ends the current item, a new trigger
+ * before any sample restarts the capture without weighing the item
+ */
+uint8_t checkweigher_process() {
+	uint32_t now = 0;
+	uint8_t triggered = 0;
+	int32_t raw = 0;
+	uint8_t ready = 0;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		now = maintimer_steps;
+		triggered = checkweigher_triggered;
+	}
+
+	//read always, so that no sample older than the trigger is integrated
+	if(hx711_isready()) {
+		raw = hx711_read();
+		checkweigher_samples++;
+		ready = 1;
+	}
+
+	if(checkweigher_capturing) {
+		//integrate
+		if(ready && now - checkweigher_step >= MAINTIMER_MS2STEPS(eepromcw_eevar.settle))
+			stats_add(&checkweigher_window, raw - hx711_getoffset());
+
+		//end of the window
+		if(triggered && checkweigher_window.n == 0) {
+			//retriggered before any sample, not an item to reject
+			checkweigher_capturing = 0;
+		} else if(triggered || now - checkweigher_step >= MAINTIMER_MS2STEPS(eepromcw_eevar.window)) {
+			checkweigher_capturing = 0;
+			checkweigher_items++;
+
+			//classify
+			if(checkweigher_window.n == 0) {
+				checkweigher_class = CHECKWEIGHER_CLASSNONE;
+			} else {
+				const band_eet *band = &eepromcw_eevar.bands[eepromitem_eevar.recipe];
+				weight_sample(stats_getmean(&checkweigher_window));
+				checkweigher_weight = weight_convert(stats_getmean(&checkweigher_window));
+				if(checkweigher_weight*1000 < band->low)
+					checkweigher_class = CHECKWEIGHER_CLASSUNDER;
+				else if(checkweigher_weight*1000 > band->high)
+					checkweigher_class = CHECKWEIGHER_CLASSOVER;
+				else
+					checkweigher_class = CHECKWEIGHER_CLASSOK;
+			}
+			return 1;
+		}
+	}
+
+	if(!checkweigher_capturing && triggered) {
+		//new item
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			checkweigher_step = checkweigher_triggerstep;
+			checkweigher_triggered = 0;
+		}
+		stats_reset(&checkweigher_window);
+		checkweigher_capturing = 1;
+	}
+
+	return 0;
 }
+#endif
+
+
+#if FLOWRATE_ENABLED == 1
+/*
+ * run the flow rate without blocking, return 1 when the rate is updated
+ * every sample is averaged, at every get weight event the average weight
+ * is added to the regression window
+ */
+uint8_t flowrate_process() {
+	//filter
+	if(hx711_isready()) {
+		int32_t raw = hx711_read() - hx711_getoffset();
+		flowrate_sum += raw;
+		flowrate_count++;
+	}
+
+	if(!getweighttrigger)
+		return 0;
+	getweighttrigger = 0;
+	if(flowrate_count == 0) {
+		//no conversion in a second, a bounded read flags the timeout
+		hx711_read();
+		return 0;
+	}
+
+	//add the filtered weight, x1000
+	weight_sample(flowrate_sum/flowrate_count);
+	int32_t w = lround(weight_convert((double)flowrate_sum/flowrate_count)*1000);
+	flowrate_sum = 0;
+	flowrate_count = 0;
+	flow_add(w, eepromflow_eevar.refill);
+
+	//loss per second to units per minute
+	flowrate_rate = -flow_getslope()*60/1000;
+	return 1;
+}
+#endif
+
+
+#if DUTYCYCLE_ENABLED == 1
+/*
+ * power the converter down until the wake up time before the next reading,
+ * ticks is the number of seconds to the next reading
+ */
+void dutycycle_process(uint8_t ticks) {
+	uint8_t waketicks = (hx711_getwaketime() + 999999UL)/1000000UL;
+	if(ticks > waketicks) {
+		if(!dutycycle_sleeping) {
+			dutycycle_sleeping = 1;
+			hx711_powerdown();
+		}
+	} else if(dutycycle_sleeping) {
+		dutycycle_sleeping = 0;
+		hx711_powerup();
+	}
+}
+#endif
+
+
+/*
+ * fast set a number, while a key is held the step grows with the hold time
+ * up to the step that sweeps the range in sweep seconds, 0 for unit steps,
+ * the value moves to the next multiple of the step and is clamped to the limits
+ */
+int32_t set_plusminus(int32_t n, int32_t max, int32_t min, uint8_t sweep) {
+	static uint8_t buttons_rpt = 0;
+	int8_t dir = 0;
+
+	if(key_getpress(1<<BUTTON_UP)) {
+		buttons_rpt = 0;
+		dir = 1;
+	}
+	if(key_getpress(1<<BUTTON_DOWN)) {
+		buttons_rpt = 0;
+		dir = -1;
+	}
+	if(key_getrpt(1<<BUTTON_UP))
+		dir = 1;
+	if(key_getrpt(1<<BUTTON_DOWN))
+		dir = -1;
+	if(dir == 0)
+		return n;
+
+	//step of the hold time, 1 2 5 10 20 50 ... up to the sweep step
+	int32_t step = 1;
+	if(sweep) {
+		int32_t stepmax = (max - min) / ((int32_t)sweep * SETPLUSMINUS_REPEATSSEC);
+		int32_t decade = 1;
+		uint8_t i = 0;
+		for(i = 0; i < buttons_rpt / SETPLUSMINUS_RAMPREPEATS; i++) {
+			int32_t next = decade * 2;
+			if(i % 3 == 1)
+				next = decade * 5;
+			else if(i % 3 == 2)
+				next = decade = decade * 10;
+			if(next > stepmax)
+				break;
+			step = next;
+		}
+		if(buttons_rpt < 0xFF)
+			buttons_rpt++;
+	}
+
+	//move to the next multiple of the step
+	int32_t r = n % step;
+	if(r < 0)
+		r += step;
+	if(dir > 0)
+		n += step - r;
+	else if(r)
+		n -= r;
+	else
+		n -= step;
+
+	if(n > max)
+		n = max;
+	if(n < min)
+		n = min;
+
+	return n;
+}
+
+
+//programming menu table
+const menu_itemt menu_progitems[] PROGMEM = {
+	{ PROGSTATUS_RECIPE, "Recipe", NULL, 0, MENU_TYPEPAGE, 0, 0, 0 },
+	{ PROGSTATUS_GETWEIGHTINTERVAL, "Interval", &eepromitem_eevar.getweight_interval, 0, MENU_TYPEUINT8, MENU_STEPSINGLE, GETWEIGHT_INTERVAL_MIN, GETWEIGHT_INTERVAL_MAX },
+	{ PROGSTATUS_GETWEIGHTTHRESHOLDERR, "Num Errors", &eepromitem_eevar.getweight_thresholderr, 0, MENU_TYPEUINT8, MENU_STEPSINGLE, GETWEIGHT_THRESHOLDERR_MIN, GETWEIGHT_THRESHOLDERR_MAX },
+	{ PROGSTATUS_GETWEIGHTTHRESHOLDDIFF, "Diff Err (x1000)", &eepromitem_eevar.getweight_thresholddiff, 0, MENU_TYPEINT16, GETWEIGHT_THRESHOLDDIFF_SWEEP, GETWEIGHT_THRESHOLDDIFF_MIN, GETWEIGHT_THRESHOLDDIFF_MAX },
+	{ PROGSTATUS_TARE, "Tare", NULL, 0, MENU_TYPEPAGE, 0, 0, 0 },
+	{ PROGSTATUS_ALERTENABLED, "Alert Enabled", &eepromitem_eevar.alert_enabled, 0, MENU_TYPEONOFF, 0, ALERT_ENABLED_MIN, ALERT_ENABLED_MAX },
+	{ PROGSTATUS_SKIPINTERVAL, "Skip Interval", &eepromitem_eevar.skip_interval, 0, MENU_TYPEUINT16, SKIP_INTERVAL_SWEEP, SKIP_INTERVAL_MIN, SKIP_INTERVAL_MAX },
+	{ PROGSTATUS_SKIPTIME, "Skip Time", &eepromitem_eevar.skip_time, 0, MENU_TYPEUINT16, MENU_STEPSINGLE, SKIP_TIME_MIN, SKIP_TIME_MAX },
+	{ PROGSTATUS_RATE, "Rate SPS", NULL, 0, MENU_TYPEPAGE, 0, 0, 0 },
+#if CHECKWEIGHER_ENABLED == 1
+	{ PROGSTATUS_CWENABLED, "Checkweigher", &eepromcw_eevar.enabled, 0, MENU_TYPEONOFF, 0, CHECKWEIGHER_ENABLED_MIN, CHECKWEIGHER_ENABLED_MAX },
+	{ PROGSTATUS_CWSETTLE, "Settle (ms)", &eepromcw_eevar.settle, 0, MENU_TYPEUINT16, CHECKWEIGHER_SETTLE_SWEEP, CHECKWEIGHER_SETTLE_MIN, CHECKWEIGHER_SETTLE_MAX },
+	{ PROGSTATUS_CWWINDOW, "Window (ms)", &eepromcw_eevar.window, 0, MENU_TYPEUINT16, CHECKWEIGHER_WINDOW_SWEEP, CHECKWEIGHER_WINDOW_MIN, CHECKWEIGHER_WINDOW_MAX },
+	{ PROGSTATUS_CWLOW, "Low (x1000)", &eepromcw_eevar.bands[0].low, sizeof(band_eet), MENU_TYPEUINT16, MENU_STEPDIGIT, CHECKWEIGHER_BAND_MIN, CHECKWEIGHER_BAND_MAX },
+	{ PROGSTATUS_CWHIGH, "High (x1000)", &eepromcw_eevar.bands[0].high, sizeof(band_eet), MENU_TYPEUINT16, MENU_STEPDIGIT, CHECKWEIGHER_BAND_MIN, CHECKWEIGHER_BAND_MAX },
+	{ PROGSTATUS_CWDELAY, "Rej. Delay (ms)", &eepromcw_eevar.reject_delay, 0, MENU_TYPEUINT16, REJECT_DELAY_SWEEP, REJECT_DELAY_MIN, REJECT_DELAY_MAX },
+	{ PROGSTATUS_CWWIDTH, "Rej. Width (ms)", &eepromcw_eevar.reject_width, 0, MENU_TYPEUINT16, REJECT_WIDTH_SWEEP, REJECT_WIDTH_MIN, REJECT_WIDTH_MAX },
+#endif
+#if FLOWRATE_ENABLED == 1
+	{ PROGSTATUS_FLENABLED, "Flow Rate", &eepromflow_eevar.enabled, 0, MENU_TYPEONOFF, 0, FLOWRATE_ENABLED_MIN, FLOWRATE_ENABLED_MAX },
+	{ PROGSTATUS_FLLOW, "Rate Low (x1000)", &eepromflow_eevar.low, 0, MENU_TYPEUINT16, MENU_STEPDIGIT, FLOWRATE_BAND_MIN, FLOWRATE_BAND_MAX },
+	{ PROGSTATUS_FLHIGH, "Rate Hi (x1000)", &eepromflow_eevar.high, 0, MENU_TYPEUINT16, MENU_STEPDIGIT, FLOWRATE_BAND_MIN, FLOWRATE_BAND_MAX },
+	{ PROGSTATUS_FLREFILL, "Refill (x1000)", &eepromflow_eevar.refill, 0, MENU_TYPEUINT16, FLOWRATE_REFILL_SWEEP, FLOWRATE_REFILL_MIN, FLOWRATE_REFILL_MAX },
+#endif
+#if CHARACTERIZE_ENABLED == 1
+	{ PROGSTATUS_CHARACTERIZE, "Characterize", NULL, 0, MENU_TYPEPAGE, 0, 0, 0 },
+#endif
+#if EVENTLOG_ENABLED == 1
+	{ PROGSTATUS_EVENTLOG, "", NULL, 0, MENU_TYPEPAGE, 0, 0, 0 },
+#endif
+#if HISTORY_ENABLED == 1
+	{ PROGSTATUS_HISTORY, "Hist", NULL, 0, MENU_TYPEPAGE, 0, 0, 0 },
+#endif
+#if CHANNELB_ENABLED == 1
+	{ PROGSTATUS_CHANNELB, "Channel B", NULL, 0, MENU_TYPEPAGE, 0, 0, 0 },
+#endif
+#if KALMAN_ENABLED == 1
+	{ PROGSTATUS_KFNOISE, "KF Noise (x1000)", &eepromkf_eevar.noise, 0, MENU_TYPEUINT16, KALMAN_NOISE_SWEEP, KALMAN_NOISE_MIN, KALMAN_NOISE_MAX },
+	{ PROGSTATUS_KFPROCESS, "KF Proc. (x1000)", &eepromkf_eevar.process, 0, MENU_TYPEUINT16, KALMAN_PROCESS_SWEEP, KALMAN_PROCESS_MIN, KALMAN_PROCESS_MAX },
+#endif
+};
+#define MENU_PROGITEMSTOT (sizeof(menu_progitems)/sizeof(menu_itemt))
+
+//calibration menu table
+const menu_itemt menu_calitems[] PROGMEM = {
+	{ CALSTATUS_GAIN, "Cal. Gain 1/4", NULL, 0, MENU_TYPEPAGE, 0, 0, 0 },
+	{ CALSTATUS_OFFSET, "Cal. Offset 2/4", NULL, 0, MENU_TYPEPAGE, 0, 0, 0 },
+	{ CALSTATUS_WEIGHT, "Cal. Weight 3/4", &eepromitem_eevar.weightcal_weight, 0, MENU_TYPEUINT16, MENU_STEPSINGLE, WEIGHTCAL_WEIGHT_MIN, WEIGHTCAL_WEIGHT_MAX },
+	{ CALSTATUS_SCALE, "Cal. Scale 4/4", NULL, 0, MENU_TYPEPAGE, 0, 0, 0 }
+};
+#define MENU_CALITEMSTOT (sizeof(menu_calitems)/sizeof(menu_itemt))
 
 
 /*
  * main loop
  */
 int main(void) {    
+#if WARMSTART_ENABLED == 1 || EVENTLOG_ENABLED == 1
+	//get and clear the reset cause
+	uint8_t resetcause = MCUCSR;
+	MCUCSR = 0;
+#endif
+
 	//watchdog disable
 	wdt_disable();
 
+#if WARMSTART_ENABLED == 1
+	//resume after a watchdog or brown-out reset
+	uint8_t warmstart_resumed = warmstart_restore(resetcause);
+#endif
+
 	//init keypad
 	key_init();
+	//init menu, the numeric fields are stepped with acceleration
+	menu_init(set_plusminus);
 	key_enabled = 1;
 
 	//set relay alert
@@ -242,9 +1740,32 @@ int main(void) {
 	RELSKIP_DDR |= (1<<RELSKIP_PINNUM); //output
 	RELSKIP_OFF;
 
+#if RECIPE_INPUTENABLED == 1
+	//set recipe input
+	RECIPE_INPUTDDR &= ~(RECIPE_INPUTMASK<<RECIPE_INPUTPINNUM); //input
+	RECIPE_INPUTPORT |= (RECIPE_INPUTMASK<<RECIPE_INPUTPINNUM); //pullup
+#endif
+
+#if CHECKWEIGHER_ENABLED == 1
+	//set checkweigher trigger
+	CHECKWEIGHER_TRIGGERDDR &= ~(1<<CHECKWEIGHER_TRIGGERPINNUM); //input
+	CHECKWEIGHER_TRIGGERPORT |= (1<<CHECKWEIGHER_TRIGGERPINNUM); //pullup
+	CHECKWEIGHER_TRIGGERINIT
+#endif
+
 	//init main timer
 	MAINTIMER_INIT
 
+#if DIAG_ENABLED == 1
+	//init diagnostics cycle counter
+	diag_init();
+#endif
+
+#if TELEMETRY_ENABLED == 1
+	//init telemetry
+	uart_init();
+#endif
+
 	//init interrupts
     sei();
 
@@ -255,47 +1776,121 @@ int main(void) {
     //lcd go home
     lcd_home();
 
-    //print welcome message
-    lcd_gotoxy(0, 0);
-    lcd_puts_p(PSTR("Ind. Wgt. Check "));
-    lcd_gotoxy(0, 1);
-	lcd_puts_p(PSTR("      t01 - v1.0"));
-    _delay_ms(1000);
-    lcd_clrscr();
-    lcd_gotoxy(0, 0);
-    lcd_puts_p(PSTR("                "));
-    lcd_gotoxy(0, 1);
-	lcd_puts_p(PSTR("        D.Gironi"));
-    _delay_ms(1000);
-
-	//init eeprom
-    eepromitem_eepromread();
-	if(((int)eepromitem_eevar.initeeprom & 0XFF) == 0xFF) { //init values
-		eepromitem_eeprominit();
+#if WARMSTART_ENABLED == 1
+	//no welcome message on a warm restart
+	if(!warmstart_resumed)
+#endif
+	{
+		//print welcome message
+		lcd_gotoxy(0, 0);
+		lcd_puts_p(PSTR("Ind. Wgt. Check "));
+		lcd_gotoxy(0, 1);
+		lcd_puts_p(PSTR("      t01 - v1.0"));
+		_delay_ms(1000);
+		lcd_clrscr();
+		lcd_gotoxy(0, 0);
+		lcd_puts_p(PSTR("                "));
+		lcd_gotoxy(0, 1);
+		lcd_puts_p(PSTR("        D.Gironi"));
+		_delay_ms(1000);
 	}
+
+	//init eeprom, the journals are written once all of them and the event log are read
+	if(eepromitem_eepromread()) { //some values set to default
+		eepromitem_writepending |= (1<<EECONF_CONF);
+	}
+
+	//init recipes
+	uint8_t i = 0;
+	for(i=0; i<RECIPE_TOT; i++)
+		runtime_compute(i);
+	recipe_load(eepromitem_eevar.recipe);
 	
+	//init calibration table
+	eepromcal_eepromread();
+
+#if CHECKWEIGHER_ENABLED == 1
+	//init checkweigher
+	if(eepromcw_eepromread()) { //some values set to default
+		eepromitem_writepending |= (1<<EECONF_CW);
+	}
+	reject_setwidth(MAINTIMER_MS2STEPS(eepromcw_eevar.reject_width));
+	checkweigher_setlockout();
+#endif
+
+#if PRODSTATS_ENABLED == 1
+	//init production statistics
+	eepromstats_eepromread();
+#endif
+
+#if EVENTLOG_ENABLED == 1
+	//init event log
+	eventlog_init();
+	//power-on resets are not logged, power cycles would overwrite the alarms
+	if(!(resetcause & (1<<PORF)))
+		eventlog_log(EVENTLOG_TYPERESET, 0, resetcause);
+#endif
+
+#if FLOWRATE_ENABLED == 1
+	//init flow rate
+	if(eepromflow_eepromread()) { //some values set to default
+		eepromitem_writepending |= (1<<EECONF_FLOW);
+	}
+#endif
+
+#if KALMAN_ENABLED == 1
+	//init kalman filter
+	if(eepromkf_eepromread()) { //some values set to default
+		eepromitem_writepending |= (1<<EECONF_KF);
+	}
+#endif
+
+	//write the defaulted journals
+	eepromitem_eepromprocess();
+
 	//init hx711
 	hx711_init(eepromitem_eevar.weightcal_gain, eepromitem_eevar.weightcal_scale, eepromitem_eevar.weightcal_offset);
+#if CHANNELB_ENABLED == 1
+	hx711_setpattern(CHANNELB_PATTERN, CHANNELB_PATTERNLEN);
+#endif
+	hx711_setrate(eepromitem_eevar.weightcal_rate);
+	hx711_measureperiod(maintimer_getus);
+#if KALMAN_ENABLED == 1
+	weight_kalmaninit();
+#endif
 
 	//set default status
 	currentstate = running;
 	lcd_clrscr();
 
-    //program status
-	uint8_t programming_status = PROGSTATUS_GETWEIGHTINTERVAL;
+    //program status, index of the menu table
+	uint8_t programming_status = 0;
 
-	//calibration status
+	//calibration status, index of the menu table
 	uint8_t calibration_status = CALSTATUS_GAIN;
 
+	//calibration point
+	uint8_t calibration_point = 0;
+
+#if CHARACTERIZE_ENABLED == 1
+	//characterization status
+	uint8_t characterize_status = CHARSTATUS_TIME;
+#endif
+
 	//check weight calibration
+#if WARMSTART_ENABLED == 1
+	if(!warmstart_resumed)
+#endif
 	if(key_getpress(1<<BUTTON_SELECT)) {
 		currentstate = calibration;
 	}
 
 	//current weight
 	double weight_current = 0;
+#if KALMAN_ENABLED == 0 || WARMSTART_ENABLED == 1
 	//previous weight
 	double weight_previous = 0;
+#endif
 
 	//get weight counter
 	uint8_t getweight_counter = 0;
@@ -315,6 +1910,38 @@ int main(void) {
 	//underline selector
 	uint8_t underlineselector = 0;
 
+#if HISTORY_ENABLED == 1
+	//history sample shown
+	uint16_t history_index = 0;
+#endif
+
+#if WARMSTART_ENABLED == 1
+	if(warmstart_resumed) {
+		//resume the weight check
+		weight_previous = warmstart.weight_previous;
+		initweight_previous = warmstart.initweight_previous;
+		weight_errors = warmstart.weight_errors;
+
+		//restore relays, the alert relay is the rejector in checkweigher mode
+		if(error_state
+#if CHECKWEIGHER_ENABLED == 1
+				&& !eepromcw_eevar.enabled
+#endif
+				)
+			RELALERT_ON;
+		if(skip_state)
+			RELSKIP_ON;
+	}
+#endif
+
+#if EVENTLOG_ENABLED == 1
+	//last skip state
+	uint8_t skip_statelast = skip_state;
+
+	//event shown
+	uint8_t eventlog_index = 0;
+#endif
+
 	//watchdog enable
 	wdt_enable(WDTO_1S);
 	
@@ -322,6 +1949,53 @@ int main(void) {
     for(;;) {
     	//watchdog reset
     	wdt_reset();	
+
+		//mark loop iteration
+		DIAG_LOOPMARK
+
+		//process eeprom write
+		eepromitem_eepromprocess();
+
+#if WARMSTART_ENABLED == 1
+		//save warm restart state
+		warmstart_save(weight_previous, initweight_previous, weight_errors);
+#endif
+
+#if EVENTLOG_ENABLED == 1
+		//log skip
+		if(skip_state != skip_statelast) {
+			skip_statelast = skip_state;
+			if(skip_state)
+				eventlog_log(EVENTLOG_TYPESKIP, 0, 0);
+		}
+
+		//process event log write
+		eventlog_process();
+#endif
+
+#if TELEMETRY_ENABLED == 1
+		//process telemetry
+		telemetry_process();
+#endif
+
+#if DUTYCYCLE_ENABLED == 1
+		//power up the converter out of the weight check
+		if(dutycycle_sleeping && (currentstate != running || skip_state))
+			dutycycle_process(0);
+#endif
+
+		//hx711 fault
+		if(currentstate == running && hx711_getfault()) {
+#if EVENTLOG_ENABLED == 1
+			eventlog_log(EVENTLOG_TYPEFAULT, 0, hx711_getfault());
+#endif
+#if CHECKWEIGHER_ENABLED == 1
+			//no reject pulses while faulted
+			reject_clear();
+#endif
+			currentstate = fault;
+			refreshlcd = 1;
+		}
 		
     	//running
     	if(currentstate == running) {
@@ -332,10 +2006,82 @@ int main(void) {
 
 				underlineselector++;
 				underlineselector %= 2;
+#if PRODSTATS_ENABLED == 1
+				if(prodstats_saved)
+					prodstats_saved--;
+#endif
+			}
+
+#if RECIPE_INPUTENABLED == 1
+			//switch recipe from input
+			if(recipe_input != eepromitem_eevar.recipe && recipe_input < RECIPE_TOT) {
+				recipe_load(recipe_input);
+
+				//restart weight check
+				weight_errors = 0;
+				getweight_counter = 0;
+				initweight_previous = 1;
+#if SPARKLINE_ENABLED == 1
+				sparkline_reset();
+#endif
+
+				//refresh lcd
+				refreshlcd = 1;
+			}
+#endif
+
+#if PRODSTATS_ENABLED == 1
+			//toggle production statistics screen
+			if(key_getshort(1<<BUTTON_SELECT)) {
+				prodstats_show = !prodstats_show;
+				refreshlcd = 1;
+			}
+			if(prodstats_show) {
+				//next page
+				if(key_getshort(1<<BUTTON_UP)) {
+					prodstats_page++;
+					prodstats_page %= PRODSTATSPAGETOT;
+					refreshlcd = 1;
+				}
+				//key combinations only, checked before the single long presses
+				//of the loop so those keep their actions
+				if(key_getlongall((1<<BUTTON_UP) | (1<<BUTTON_DOWN))) {
+					//reset statistics
+					memset(&prodstats, 0, sizeof(prodstats_t));
+					refreshlcd = 1;
+				}
+				if(key_getlongall((1<<BUTTON_SELECT) | (1<<BUTTON_DOWN))) {
+					//save a snapshot
+					eepromstats_eepromwrite();
+					prodstats_saved = PRODSTATS_SAVEDTIME;
+					refreshlcd = 1;
+				}
+			}
+#endif
+
+#if DIAG_ENABLED == 1
+			//toggle diagnostics screen
+			if(key_getlong(1<<BUTTON_UP)) {
+				diag_show = !diag_show;
+				refreshlcd = 1;
+			}
+			if(diag_show) {
+				//next diagnostics page
+				if(key_getshort(1<<BUTTON_UP)) {
+					diag_page++;
+					diag_page %= DIAGPAGETOT;
+					refreshlcd = 1;
+				}
+				//reset diagnostics
+				if(key_getshort(1<<BUTTON_DOWN)) {
+					diag_reset();
+					refreshlcd = 1;
+				}
 			}
+#endif
 
 			//show skip time
-			if(eepromitem_eevar.skip_interval != 0 && !error_state && key_getshort(1<<BUTTON_UP)) {
+			if(runtime->skip_interval != 0 && !error_state && key_getshort(1<<BUTTON_UP)) {
 				showskiptime = 1;
 			}
 
@@ -348,31 +2094,137 @@ int main(void) {
 
 					lcd_clrscr();
 
-					//write skip time
-					lcd_gotoxy(0, 0);
-					lcd_puts_p(PSTR("Skip time..."));
-					lcd_gotoxy(1, 1);
-					lcd_writedouble((eepromitem_eevar.skip_time * 60 - skip_timecounter - 1)/60 + 1, 2, 0);
+#if PRODSTATS_ENABLED == 1
+					if(prodstats_show) {
+						//write production statistics
+						prodstats_lcdprint(prodstats_page);
+					} else
+#endif
+#if DIAG_ENABLED == 1
+					if(diag_show) {
+						//write diagnostics
+						diag_lcdprint(diag_page);
+					} else
+#endif
+					{
+						//write skip time
+						lcd_gotoxy(0, 0);
+						lcd_puts_p(PSTR("Skip time..."));
+						lcd_gotoxy(1, 1);
+						lcd_writedouble((runtime->skip_time - skip_timecounter - 1)/60 + 1, 2, 0);
 
-					//print underline selector
-					if(underlineselector) {
-						lcd_gotoxy(0, 1);
-						lcd_puts_p(PSTR("_"));
+						//print underline selector
+						if(underlineselector) {
+							lcd_gotoxy(0, 1);
+							lcd_puts_p(PSTR("_"));
+						}
 					}
 				}
 
 			//full running mode
 			} else {
+#if KALMAN_ENABLED == 1
+				//filter each conversion in the standard mode
+				if(
+#if CHECKWEIGHER_ENABLED == 1
+						!eepromcw_eevar.enabled &&
+#endif
+#if FLOWRATE_ENABLED == 1
+						!eepromflow_eevar.enabled &&
+#endif
+						hx711_isready())
+					weight_kalmansample();
+#else
+				//read each conversion in the standard mode while the period is measured,
+				//polling the chip reads the channel B bursts in background
+				if(
+#if CHECKWEIGHER_ENABLED == 1
+						!eepromcw_eevar.enabled &&
+#endif
+#if FLOWRATE_ENABLED == 1
+						!eepromflow_eevar.enabled &&
+#endif
+						hx711_isready() && hx711_ismeasuring())
+					hx711_read();
+#endif
+#if CHECKWEIGHER_ENABLED == 1
+				//weigh the items
+				if(eepromcw_eevar.enabled) {
+					if(getweighttrigger) {
+						getweighttrigger = 0;
+						//no conversion in a second, a bounded read flags the timeout
+						if(checkweigher_samples == 0)
+							hx711_read();
+						checkweigher_samples = 0;
+					}
+					if(checkweigher_process()) {
+						//check item, reject it downstream
+						if(eepromitem_eevar.alert_enabled) {
+							if(checkweigher_class != CHECKWEIGHER_CLASSOK) {
+								weight_errors++;
+								if(!reject_push(checkweigher_step + MAINTIMER_MS2STEPS(eepromcw_eevar.reject_delay))) {
+									//queue full, the item passes
+									error_state = 1;
+								}
+							} else {
+								//reset errors
+								weight_errors = 0;
+							}
+						}
+
+						//refresh lcd
+						refreshlcd = 1;
+					}
+				} else
+#endif
+#if FLOWRATE_ENABLED == 1
+				//compute the flow rate
+				if(eepromflow_eevar.enabled) {
+					if(flowrate_process()) {
+						//check rate band, once the window is full
+						if(eepromitem_eevar.alert_enabled && flow_getcount() == FLOW_WINDOW) {
+							if(flowrate_rate*1000 < eepromflow_eevar.low || flowrate_rate*1000 > eepromflow_eevar.high) {
+								weight_errors++;
+							} else {
+								//reset errors
+								weight_errors = 0;
+							}
+						}
+
+						//refresh lcd
+						refreshlcd = 1;
+					}
+				} else
+#endif
 				//get weight and check diff
 				if(getweighttrigger) {
 					getweighttrigger = 0;
+#if KALMAN_ENABLED == 1
+					//no conversion in a second, a bounded read flags the timeout
+					if(weight_kalmansamples == 0)
+						hx711_read();
+					weight_kalmansps = weight_kalmansamples;
+					weight_kalmansamples = 0;
+#endif
 
 					getweight_counter++;
-					if(getweight_counter >= eepromitem_eevar.getweight_interval) {
+					if(getweight_counter >= runtime->getweight_interval) {
 						getweight_counter = 0;
 
+#if KALMAN_ENABLED == 1
+						//get the filtered weight, the diff is the rate over the interval
+						weight_sample(kalman_getmass());
+						weight_current = weight_convert(kalman_getmass());
+						if(initweight_previous) {
+							initweight_previous = 0;
+							kalman_reset();
+						}
+						weight_diff = weight_getchange(runtime->getweight_interval);
+#else
 						//get weight
-						weight_current = hx711_getweight();
+						DIAG_START(hx711start)
+						weight_current = weight_get();
+						DIAG_STOPHX711(hx711start)
 						if(initweight_previous) {
 							initweight_previous = 0;
 							weight_previous = weight_current;
@@ -383,10 +2235,24 @@ int main(void) {
 
 						//update previous weight
 						weight_previous = weight_current;
+#endif
+#if SPARKLINE_ENABLED == 1
+						sparkline_add(lround(weight_diff*1000));
+#endif
+
+#if PRODSTATS_ENABLED == 1
+						//update production statistics
+						prodstats_add(weight_current, weight_diff);
+#endif
 
 						//check weight diff
-						if(eepromitem_eevar.alert_enabled) {
-							if(weight_diff < (double)eepromitem_eevar.getweight_thresholddiff/1000.0) {
+						if(eepromitem_eevar.alert_enabled
+#if KALMAN_ENABLED == 1
+								//check only a settled filter, the rate converges after a restart
+								&& kalman_issettled()
+#endif
+								) {
+							if(weight_diff < runtime->getweight_thresholddiff) {
 								weight_errors++;
 							} else {
 								//reset errors
@@ -395,6 +2261,11 @@ int main(void) {
 						}
 					}				
 
+#if DUTYCYCLE_ENABLED == 1
+					//power down until the next reading
+					dutycycle_process(runtime->getweight_interval - getweight_counter);
+#endif
+
 					//refresh lcd
 					refreshlcd = 1;
 				}
@@ -403,12 +2274,19 @@ int main(void) {
 				if(error_state) {
 					//reset error
 					if(key_getlong(1<<BUTTON_DOWN)) {
+#if EVENTLOG_ENABLED == 1
+						eventlog_log(EVENTLOG_TYPEALARMCLEAR, weight_diff, weight_errors);
+#endif
+
 						//reset errors
 						weight_errors = 0;
 						error_state = 0;
 						initweight_previous = 1;
 
-						//reset alert
+						//reset alert, the reject queue owns the relay in checkweigher mode
+#if CHECKWEIGHER_ENABLED == 1
+						if(!eepromcw_eevar.enabled)
+#endif
 						RELALERT_OFF;
 
 						//refresh lcd
@@ -416,20 +2294,55 @@ int main(void) {
 					}
 				} else {
 					//check error threshold
-					if(weight_errors >= eepromitem_eevar.getweight_thresholderr) {
+					if(weight_errors >= runtime->getweight_thresholderr) {
 						error_state = 1;
-
-						//set alert
+#if PRODSTATS_ENABLED == 1
+						if(prodstats.alarms < 0xFFFF)
+							prodstats.alarms++;
+#endif
+#if EVENTLOG_ENABLED == 1
+						eventlog_log(EVENTLOG_TYPEALARM, weight_diff, weight_errors);
+#endif
+#if HISTORY_ENABLED == 1
+						history_trigger();
+#endif
+
+						//set alert, the relay is the rejector in checkweigher mode
+#if CHECKWEIGHER_ENABLED == 1
+						if(!eepromcw_eevar.enabled)
+#endif
 						RELALERT_ON; 
 					}
+
+#if FLOWRATE_ENABLED == 1
+					//reset totalizer
+					if(eepromflow_eevar.enabled && key_getlong(1<<BUTTON_DOWN)) {
+						flow_resettotal();
+						refreshlcd = 1;
+					}
+#endif
 				}
 
 				//print out to lcd
 				if(refreshlcd) {
 					refreshlcd = 0;
 
+					DIAG_START(lcdstart)
+
 					lcd_clrscr();
 
+#if PRODSTATS_ENABLED == 1
+					if(prodstats_show) {
+						//write production statistics
+						prodstats_lcdprint(prodstats_page);
+					} else
+#endif
+#if DIAG_ENABLED == 1
+					if(diag_show) {
+						//write diagnostics
+						diag_lcdprint(diag_page);
+					} else
+#endif
 					if(error_state) {
 						//write alert on
 						lcd_gotoxy(0, 0);
@@ -442,8 +2355,65 @@ int main(void) {
 							lcd_gotoxy(0, 0);
 							lcd_puts_p(PSTR("Skip interval..."));
 							lcd_gotoxy(1, 1);
-							lcd_writedouble((eepromitem_eevar.skip_interval * 60 - skip_intervalcounter - 1)/60 + 1, 4, 0);
-						} else {
+							lcd_writedouble((runtime->skip_interval - skip_intervalcounter - 1)/60 + 1, 4, 0);
+						}
+#if CHECKWEIGHER_ENABLED == 1
+						else if(eepromcw_eevar.enabled) {
+							//write last item class and weight
+							lcd_gotoxy(0, 0);
+							if(checkweigher_items == 0)
+								lcd_puts_p(PSTR("--"));
+							else if(checkweigher_class == CHECKWEIGHER_CLASSOK)
+								lcd_puts_p(PSTR("Ok"));
+							else if(checkweigher_class == CHECKWEIGHER_CLASSUNDER)
+								lcd_puts_p(PSTR("Un"));
+							else if(checkweigher_class == CHECKWEIGHER_CLASSOVER)
+								lcd_puts_p(PSTR("Ov"));
+							else
+								lcd_puts_p(PSTR("No"));
+#if RECIPE_TOT > 1
+							lcd_gotoxy(4, 0);
+							lcd_writelong(eepromitem_eevar.recipe + 1);
+#endif
+							lcd_gotoxy(6, 0);
+							lcd_writedouble(checkweigher_weight, 10, 2);
+
+							//write errors and items
+							lcd_gotoxy(0, 1);
+							lcd_puts_p(PSTR("e"));
+							lcd_gotoxy(1, 1);
+							lcd_writedouble(weight_errors, 2, 0);
+							lcd_gotoxy(6, 1);
+							lcd_writelong(checkweigher_items);
+						}
+#endif
+#if FLOWRATE_ENABLED == 1
+						else if(eepromflow_eevar.enabled) {
+							//write flow rate, units per minute
+							lcd_gotoxy(0, 0);
+							lcd_puts_p(PSTR("/m"));
+#if RECIPE_TOT > 1
+							lcd_gotoxy(4, 0);
+							lcd_writelong(eepromitem_eevar.recipe + 1);
+#endif
+							lcd_gotoxy(6, 0);
+							lcd_writedouble(flowrate_rate, 10, 2);
+
+							//write errors and total
+							lcd_gotoxy(0, 1);
+							lcd_puts_p(PSTR("e"));
+							lcd_gotoxy(1, 1);
+							lcd_writedouble(weight_errors, 2, 0);
+							lcd_gotoxy(6, 1);
+							lcd_writedouble((double)flow_gettotal()/1000, 10, 2);
+						}
+#endif
+						else {
+#if SPARKLINE_ENABLED == 1
+							//write the changed sparkline glyphs, before the position is set
+							sparkline_update();
+#endif
+
 							//write current weight
 							lcd_gotoxy(0, 0);
 							if(underlineselector) {
@@ -451,7 +2421,11 @@ int main(void) {
 								lcd_puts_p(PSTR("_"));
 							}
 							lcd_gotoxy(1, 0);
-							lcd_writedouble(eepromitem_eevar.getweight_interval - getweight_counter, 2, 0);
+							lcd_writedouble(runtime->getweight_interval - getweight_counter, 2, 0);
+#if RECIPE_TOT > 1
+							lcd_gotoxy(4, 0);
+							lcd_writelong(eepromitem_eevar.recipe + 1);
+#endif
 							lcd_gotoxy(6, 0);
 							lcd_writedouble(weight_current, 10, 2);
 
@@ -460,10 +2434,24 @@ int main(void) {
 							lcd_puts_p(PSTR("e"));
 							lcd_gotoxy(1, 1);
 							lcd_writedouble(weight_errors, 2, 0);
+#if SPARKLINE_ENABLED == 1
+							//write the differences sparkline, the difference fits the last 5 chars,
+							//the precision drops with the magnitude, beyond 5 digits an overflow mark
+							lcd_gotoxy(3, 1);
+							sparkline_lcdprint();
+							lcd_gotoxy(11, 1);
+							if(weight_diff >= 99999.5 || weight_diff <= -9999.5)
+								lcd_puts_p(weight_diff > 0 ? PSTR(" +ovf") : PSTR(" -ovf"));
+							else
+								lcd_writedouble(weight_diff, 5, fabs(weight_diff) < 9.995 ? 2 : (fabs(weight_diff) < 99.95 ? 1 : 0));
+#else
 							lcd_gotoxy(6, 1);
 							lcd_writedouble(weight_diff, 10, 2);
+#endif
 						}
 					}
+
+					DIAG_STOPLCD(lcdstart)
 				}
 			}
 			
@@ -493,73 +2481,123 @@ int main(void) {
 
 		//calibration
     	else if(currentstate == calibration) {
+			//menu item of the page
+			menu_itemt item;
+			menu_getitem(menu_calitems, calibration_status, &item, eepromitem_eevar.recipe);
 
-			if(calibration_status == CALSTATUS_GAIN) {
-				//calibration gain
-				lcd_gotoxy(0, 0);
-				lcd_puts_p(PSTR("Cal. Gain 1/4"));
+			//edit the field, draw the page on change only
+			if(menu_edit(&item))
+				refreshlcd = 1;
+			uint8_t redraw = refreshlcd;
+			if(refreshlcd) {
+				refreshlcd = 0;
+				menu_lcdprint(&item);
+			}
 
-				lcd_gotoxy(0, 1);
-				if(eepromitem_eevar.weightcal_gain == HX711_GAINCHANNELA128)
-					lcd_puts_p(PSTR("128"));
-				else if(eepromitem_eevar.weightcal_gain == HX711_GAINCHANNELA64)
-					lcd_puts_p(PSTR(" 64"));
+			switch(item.id) {
+			case CALSTATUS_GAIN:
+				//calibration gain
+				if(redraw) {
+					lcd_gotoxy(0, 1);
+					if(eepromitem_eevar.weightcal_gain == HX711_GAINCHANNELA128)
+						lcd_puts_p(PSTR("128"));
+					else if(eepromitem_eevar.weightcal_gain == HX711_GAINCHANNELA64)
+						lcd_puts_p(PSTR(" 64"));
+				}
 
 				if(key_getshort(1<<BUTTON_UP)) {
 					eepromitem_eevar.weightcal_gain = HX711_GAINCHANNELA128;
 					hx711_setgain(HX711_GAINCHANNELA128);
+					refreshlcd = 1;
 				}
 				if(key_getshort(1<<BUTTON_DOWN)) {
 					eepromitem_eevar.weightcal_gain = HX711_GAINCHANNELA64;
 					hx711_setgain(HX711_GAINCHANNELA64);
+					refreshlcd = 1;
 				}
-			} else if(calibration_status == CALSTATUS_OFFSET) {
-				//calibration offset
-				lcd_gotoxy(0, 0);
-				lcd_puts_p(PSTR("Cal. Offset 2/4"));
+				break;
 
-				lcd_gotoxy(0, 1);
-				lcd_writelong(eepromitem_eevar.weightcal_offset);
+			case CALSTATUS_OFFSET:
+				//calibration offset
+				if(calsampler_running) {
+					calsampler_lcdprint();
+				} else if(redraw) {
+					lcd_gotoxy(0, 1);
+					lcd_writelong(eepromitem_eevar.weightcal_offset);
+				}
 
-				if(key_getlong(1<<BUTTON_UP)) {
-					hx711_calibrate1setoffset();
+				if(!calsampler_running && key_getlong(1<<BUTTON_UP)) {
+					calsampler_start();
+					refreshlcd = 1;
+				}
+				if(calsampler_process()) {
+					hx711_setoffset(stats_getmean(&calsampler_stats));
 					eepromitem_eevar.weightcal_offset = hx711_getoffset();
-					lcd_clrscr();
+					refreshlcd = 1;
 				}
-				
-			} else if(calibration_status == CALSTATUS_WEIGHT) {
-				//calibration weight
-				lcd_gotoxy(0, 0);
-				lcd_puts_p(PSTR("Cal. Weight 3/4"));
-
-				lcd_gotoxy(0, 1);
-				lcd_writelong(eepromitem_eevar.weightcal_weight);
+				break;
+
+			case CALSTATUS_WEIGHT:
+				//calibration weight, the value is drawn by the menu
+				if(redraw) {
+					lcd_gotoxy(13, 1);
+					lcd_puts_p(PSTR("P"));
+					lcd_writelong(calibration_point + 1);
+				}
+				break;
 
-				uint16_t weightcal_weight = eepromitem_eevar.weightcal_weight;				
-				eepromitem_eevar.weightcal_weight = set_plusminus((uint16_t)eepromitem_eevar.weightcal_weight, WEIGHTCAL_WEIGHT_MAX, WEIGHTCAL_WEIGHT_MIN);
-				if(eepromitem_eevar.weightcal_weight != weightcal_weight)
-					lcd_clrscr();
-			} else if(calibration_status == CALSTATUS_SCALE) {
+			case CALSTATUS_SCALE:
 				//calibration scale
-				lcd_gotoxy(0, 0);
-				lcd_puts_p(PSTR("Cal. Scale 4/4"));
-
-				lcd_gotoxy(0, 1);
-				lcd_writelong((int32_t)eepromitem_eevar.weightcal_scale);
+				if(calsampler_running) {
+					calsampler_lcdprint();
+				} else if(redraw) {
+					lcd_gotoxy(0, 1);
+					lcd_puts_p(PSTR("P"));
+					lcd_writelong(calibration_point + 1);
+					lcd_gotoxy(4, 1);
+					lcd_writelong((int32_t)eepromitem_eevar.weightcal_scale);
+					lcd_gotoxy(13, 1);
+					lcd_writelong(eepromcal_eevar.count);
+				}
 
-				if(key_getlong(1<<BUTTON_UP)) {
-					hx711_calibrate2setscale(((double)eepromitem_eevar.weightcal_weight));
-					eepromitem_eevar.weightcal_scale = hx711_getscale();
-					lcd_clrscr();
+				if(!calsampler_running && key_getlong(1<<BUTTON_UP)) {
+					calsampler_start();
+					refreshlcd = 1;
+				}
+				if(calsampler_process()) {
+					//capture the point, the first point restarts the table
+					int32_t raw = stats_getmean(&calsampler_stats) - hx711_getoffset();
+					if(calibration_point == 0) {
+						eepromcal_eevar.count = 0;
+						//the first point also sets the linear scale
+						hx711_setscale((double)raw/(double)eepromitem_eevar.weightcal_weight);
+						eepromitem_eevar.weightcal_scale = hx711_getscale();
+					}
+					eepromcal_eevar.points[calibration_point].raw = raw;
+					eepromcal_eevar.points[calibration_point].weight = eepromitem_eevar.weightcal_weight;
+					if(calibration_point == eepromcal_eevar.count)
+						eepromcal_eevar.count++;
+					lincal_setpoints(eepromcal_eevar.points, eepromcal_eevar.count);
+
+					//next point
+					if(calibration_point < LINCAL_POINTSMAX-1) {
+						calibration_point++;
+						calibration_status = CALSTATUS_WEIGHT;
+					}
+					refreshlcd = 1;
 				}
+				break;
 			}
 
 			//check change status
     		if(key_getshort(1<<BUTTON_SELECT)) {
     			calibration_status++;
-    			calibration_status %= CALSTATUSTOT;
+    			calibration_status %= MENU_CALITEMSTOT;
+
+				//abort sampling
+				calsampler_running = 0;
 
-    			lcd_clrscr();
+    			refreshlcd = 1;
 			}
 			
 			//check change status
@@ -574,6 +2612,9 @@ int main(void) {
 				skip_intervalcounter = 0;
 				skip_timecounter = 0;
 
+				//abort sampling
+				calsampler_running = 0;
+
 				currentstate = running;
 				lcd_clrscr();
 
@@ -581,100 +2622,353 @@ int main(void) {
 				refreshlcd = 1;
 
 				eepromitem_eepromwrite();
+				eepromcal_eepromwrite();
+#if SPARKLINE_ENABLED == 1
+				sparkline_reset();
+#endif
+#if KALMAN_ENABLED == 1
+				//the noises are scaled by the calibration
+				weight_kalmaninit();
+#endif
 			}
 		}
 
-    	//programming
-    	else if(currentstate == programming) {
+		//hx711 fault
+		else if(currentstate == fault) {
+			//set alert, a pending reject pulse may have reset it
+			RELALERT_ON;
 
-			if(programming_status == PROGSTATUS_GETWEIGHTINTERVAL) {
-				//motor direction
-				lcd_gotoxy(0, 0);
-				lcd_puts_p(PSTR("Interval"));
+			//print out to lcd
+			if(refreshlcd) {
+				refreshlcd = 0;
 
+				lcd_clrscr();
+				lcd_gotoxy(0, 0);
+				lcd_puts_p(PSTR("HX711 Fault"));
 				lcd_gotoxy(0, 1);
-				lcd_writelong(eepromitem_eevar.getweight_interval);
+				if(hx711_getfault() & HX711_FAULTTIMEOUT)
+					lcd_puts_p(PSTR("Tout "));
+				if(hx711_getfault() & HX711_FAULTRAIL)
+					lcd_puts_p(PSTR("Rail "));
+				if(hx711_getfault() & HX711_FAULTSTUCK)
+					lcd_puts_p(PSTR("Stuck"));
+			}
 
-				uint8_t getweight_interval = eepromitem_eevar.getweight_interval;
-				eepromitem_eevar.getweight_interval = set_plusminus(eepromitem_eevar.getweight_interval, GETWEIGHT_INTERVAL_MAX, GETWEIGHT_INTERVAL_MIN);
-				if(getweight_interval != eepromitem_eevar.getweight_interval)
-					lcd_clrscr();
-			} else if(programming_status == PROGSTATUS_GETWEIGHTTHRESHOLDERR) {
-				//motor direction
+			//reset fault, restart the weight check
+			if(key_getlong(1<<BUTTON_DOWN)) {
+				hx711_clearfault();
+				weight_errors = 0;
+				initweight_previous = 1;
+
+				//reset alert, unless an alarm is latched
+				if(!error_state)
+					RELALERT_OFF;
+
+				currentstate = running;
+				lcd_clrscr();
+
+				//refresh lcd
+				refreshlcd = 1;
+			}
+		}
+
+#if CHARACTERIZE_ENABLED == 1
+		//noise characterization
+		else if(currentstate == characterize) {
+
+			if(characterize_status == CHARSTATUS_TIME) {
+				//sampling time
 				lcd_gotoxy(0, 0);
-				lcd_puts_p(PSTR("Num Errors"));
+				lcd_puts_p(PSTR("Char. Time"));
 
 				lcd_gotoxy(0, 1);
-				lcd_writelong(eepromitem_eevar.getweight_thresholderr);
+				lcd_writelong(characterize_time);
+
+				uint16_t time = characterize_time;
+				characterize_time = set_plusminus(characterize_time, CHARACTERIZE_TIME_MAX, CHARACTERIZE_TIME_MIN, CHARACTERIZE_TIME_SWEEP);
+				if(time != characterize_time)
+					lcd_clrscr();
 
-				uint8_t getweight_thresholderr = eepromitem_eevar.getweight_thresholderr;
-				eepromitem_eevar.getweight_thresholderr = set_plusminus(eepromitem_eevar.getweight_thresholderr, GETWEIGHT_THRESHOLDERR_MAX, GETWEIGHT_THRESHOLDERR_MIN);
-				if(getweight_thresholderr != eepromitem_eevar.getweight_thresholderr)
+				if(key_getlong(1<<BUTTON_UP)) {
+					characterize_start();
+					characterize_status = CHARSTATUS_UNLOADED;
 					lcd_clrscr();
-			} else if(programming_status == PROGSTATUS_GETWEIGHTTHRESHOLDDIFF) {
-				//motor direction
+				}
+			} else if(characterize_status == CHARSTATUS_UNLOADED || characterize_status == CHARSTATUS_LOADED) {
+				//sampling
 				lcd_gotoxy(0, 0);
-				lcd_puts_p(PSTR("Diff Err (x1000)"));
+				if(characterize_status == CHARSTATUS_UNLOADED)
+					lcd_puts_p(PSTR("Unloaded"));
+				else
+					lcd_puts_p(PSTR("Loaded"));
 
 				lcd_gotoxy(0, 1);
-				lcd_writelong(eepromitem_eevar.getweight_thresholddiff);
+				lcd_writelong(characterize_time - characterize_seconds);
+				lcd_puts_p(PSTR(" "));
 
-				int16_t getweight_thresholddiff = eepromitem_eevar.getweight_thresholddiff;
-				eepromitem_eevar.getweight_thresholddiff = set_plusminus(eepromitem_eevar.getweight_thresholddiff, GETWEIGHT_THRESHOLDDIFF_MAX, GETWEIGHT_THRESHOLDDIFF_MIN);
-				if(getweight_thresholddiff != eepromitem_eevar.getweight_thresholddiff)
+				if(characterize_process()) {
+					if(characterize_status == CHARSTATUS_UNLOADED) {
+						noise_getresult(&characterize_unloaded);
+						characterize_status = CHARSTATUS_LOAD;
+					} else {
+						noise_getresult(&characterize_loaded);
+						characterize_recommend();
+						characterize_status = CHARSTATUS_RESULTUNLOADED;
+					}
 					lcd_clrscr();
-			} else if(programming_status == PROGSTATUS_TARE) {
-				//motor max speed
+				}
+			} else if(characterize_status == CHARSTATUS_LOAD) {
+				//wait for the load
 				lcd_gotoxy(0, 0);
-				lcd_puts_p(PSTR("Tare"));
-
-				lcd_gotoxy(0, 1);
-				lcd_writelong(eepromitem_eevar.weightcal_offset);
+				lcd_puts_p(PSTR("Load, Up to run"));
 
 				if(key_getlong(1<<BUTTON_UP)) {
-					hx711_taretozero();
-					eepromitem_eevar.weightcal_offset = hx711_getoffset();
+					characterize_start();
+					characterize_status = CHARSTATUS_LOADED;
 					lcd_clrscr();
-				}					
-			} else if(programming_status == PROGSTATUS_ALERTENABLED) {
-				//motor max speed
+				}
+			} else if(characterize_status == CHARSTATUS_RESULTUNLOADED) {
+				//unloaded noise
+				lcd_gotoxy(0, 0);
+				lcd_puts_p(PSTR("Unl. Sd      Pp"));
+				characterize_lcdprint(&characterize_unloaded);
+			} else if(characterize_status == CHARSTATUS_RESULTLOADED) {
+				//loaded noise
+				lcd_gotoxy(0, 0);
+				lcd_puts_p(PSTR("Load Sd      Pp"));
+				characterize_lcdprint(&characterize_loaded);
+			} else if(characterize_status == CHARSTATUS_RESULTADEV) {
+				//allan deviation at the interval and effective bits, worst run
 				lcd_gotoxy(0, 0);
-				lcd_puts_p(PSTR("Alert Enabled"));
+				lcd_puts_p(PSTR("Adev       ENOB"));
 
-				lcd_gotoxy(13, 1);
-				if(eepromitem_eevar.alert_enabled)
-					lcd_puts_p(PSTR(" On"));
-				else
-					lcd_puts_p(PSTR("Off"));
-
-				if(key_getshort(1<<BUTTON_UP))
-					eepromitem_eevar.alert_enabled = 1;
-				if(key_getshort(1<<BUTTON_DOWN))
-					eepromitem_eevar.alert_enabled = 0;					
-			} else if(programming_status == PROGSTATUS_SKIPINTERVAL) {
-				//motor direction
+				lcd_gotoxy(0, 1);
+				lcd_writedouble(fmax(characterize_unloaded.allandev, characterize_loaded.allandev)/hx711_getscale(), 7, 3);
+				lcd_gotoxy(10, 1);
+				lcd_writedouble(fmin(characterize_unloaded.enob, characterize_loaded.enob), 5, 1);
+			} else if(characterize_status == CHARSTATUS_RESULTRECOMMEND) {
+				//recommended thresholds, up to apply
 				lcd_gotoxy(0, 0);
-				lcd_puts_p(PSTR("Skip Interval"));
+				if(characterize_applied)
+					lcd_puts_p(PSTR("Applied         "));
+				else
+					lcd_puts_p(PSTR("Rec. Diff   Errs"));
 
 				lcd_gotoxy(0, 1);
-				lcd_writelong(eepromitem_eevar.skip_interval);
+				lcd_writelong(characterize_thresholddiff);
+				lcd_gotoxy(13, 1);
+				lcd_writelong(characterize_thresholderr);
 
-				uint8_t skip_interval = eepromitem_eevar.skip_interval;
-				eepromitem_eevar.skip_interval = set_plusminus(eepromitem_eevar.skip_interval, SKIP_INTERVAL_MAX, SKIP_INTERVAL_MIN);
-				if(skip_interval != eepromitem_eevar.skip_interval)
-					lcd_clrscr();
-			} else if(programming_status == PROGSTATUS_SKIPTIME) {
-				//motor direction
-				lcd_gotoxy(0, 0);
-				lcd_puts_p(PSTR("Skip Time"));
+				if(key_getlong(1<<BUTTON_UP)) {
+					eepromitem_eevar.getweight_thresholderr = characterize_thresholderr;
+					eepromitem_eevar.getweight_thresholddiff = characterize_thresholddiff;
+					characterize_applied = CHARACTERIZE_APPLIEDTIME;
+					onesectrigger = 0;
+				}
+
+				//show the applied message for a while
+				if(characterize_applied && onesectrigger) {
+					onesectrigger = 0;
+					characterize_applied--;
+				}
+			}
+
+			//check change status, results pages only
+			if(key_getshort(1<<BUTTON_SELECT) && characterize_status >= CHARSTATUS_RESULTUNLOADED) {
+				characterize_status++;
+				if(characterize_status > CHARSTATUS_RESULTRECOMMEND)
+					characterize_status = CHARSTATUS_RESULTUNLOADED;
+				characterize_applied = 0;
+
+				lcd_clrscr();
+			}
+
+			//back to programming
+			if(key_getlong(1<<BUTTON_SELECT)) {
+				characterize_running = 0;
+				currentstate = programming;
+				lcd_clrscr();
+
+				//refresh lcd
+				refreshlcd = 1;
+			}
+		}
+#endif
+
+    	//programming
+    	else if(currentstate == programming) {
+			//menu item of the page
+			menu_itemt item;
+			menu_getitem(menu_progitems, programming_status, &item, eepromitem_eevar.recipe);
+
+			//edit the field, draw the page on change only
+			if(menu_edit(&item))
+				refreshlcd = 1;
+			uint8_t redraw = refreshlcd;
+			if(refreshlcd) {
+				refreshlcd = 0;
+				menu_lcdprint(&item);
+			}
+
+			switch(item.id) {
+			case PROGSTATUS_RECIPE: {
+				//recipe
+				if(redraw) {
+					lcd_gotoxy(0, 1);
+					lcd_writelong(eepromitem_eevar.recipe + 1);
+				}
+
+				uint8_t recipe = set_plusminus(eepromitem_eevar.recipe + 1, RECIPE_TOT, 1, MENU_STEPSINGLE) - 1;
+				if(recipe != eepromitem_eevar.recipe) {
+					recipe_store();
+					recipe_load(recipe);
+					refreshlcd = 1;
+				}
+				break;
+			}
+
+			case PROGSTATUS_TARE:
+				//tare
+				if(redraw) {
+					lcd_gotoxy(0, 1);
+					lcd_writelong(eepromitem_eevar.weightcal_offset);
+				}
+
+				if(key_getlong(1<<BUTTON_UP)) {
+					hx711_taretozero();
+					eepromitem_eevar.weightcal_offset = hx711_getoffset();
+					refreshlcd = 1;
+				}
+				break;
+
+			case PROGSTATUS_RATE:
+				//hx711 rate, measured and set, the period is measured again on exit
+				if(redraw) {
+					lcd_gotoxy(0, 1);
+					lcd_writelong(1000000L/hx711_getperiod());
+#if HX711_RATEPINENABLED == 1
+					lcd_gotoxy(13, 1);
+					if(eepromitem_eevar.weightcal_rate == HX711_RATE80SPS)
+						lcd_puts_p(PSTR(" 80"));
+					else
+						lcd_puts_p(PSTR(" 10"));
+#endif
+				}
+
+#if HX711_RATEPINENABLED == 1
+				if(key_getshort(1<<BUTTON_UP)) {
+					eepromitem_eevar.weightcal_rate = HX711_RATE80SPS;
+					refreshlcd = 1;
+				}
+				if(key_getshort(1<<BUTTON_DOWN)) {
+					eepromitem_eevar.weightcal_rate = HX711_RATE10SPS;
+					refreshlcd = 1;
+				}
+#endif
+				break;
+
+#if HISTORY_ENABLED == 1
+			case PROGSTATUS_HISTORY:
+				//sample history, up newer, down older, long down releases
+				if(redraw) {
+					int32_t x = 0;
+					if(history_isfrozen()) {
+						lcd_gotoxy(4, 0);
+						lcd_puts_p(PSTR("*"));
+					}
+					if(history_index >= history_getcount())
+						history_index = 0;
+					if(history_get(history_index, &x)) {
+						lcd_gotoxy(6, 0);
+						lcd_writelong((int32_t)history_index - history_getpre());
+						lcd_gotoxy(0, 1);
+						lcd_writelong(x);
+					}
+				}
+
+				if(key_getshort(1<<BUTTON_UP) && history_index + 1 < history_getcount()) {
+					history_index++;
+					refreshlcd = 1;
+				}
+				if(key_getshort(1<<BUTTON_DOWN) && history_index > 0) {
+					history_index--;
+					refreshlcd = 1;
+				}
+				if(key_getlong(1<<BUTTON_DOWN)) {
+					history_release();
+					history_index = 0;
+					refreshlcd = 1;
+				}
+				break;
+#endif
+
+#if CHANNELB_ENABLED == 1
+			case PROGSTATUS_CHANNELB:
+				//channel B raw value and samples, drawn on every loop
+				if(hx711_isready())
+					hx711_read();
+
+				lcd_gotoxy(10, 0);
+				lcd_writelong(hx711_getchannelbcount());
+				lcd_puts_p(PSTR("     "));
 
 				lcd_gotoxy(0, 1);
-				lcd_writelong(eepromitem_eevar.skip_time);
+				lcd_writelong(hx711_getchannelb() - 0x800000L);
+				lcd_puts_p(PSTR("        "));
+				break;
+#endif
+
+#if EVENTLOG_ENABLED == 1
+			case PROGSTATUS_EVENTLOG:
+				//event log, up older, down newer
+				if(redraw) {
+					eventlog_eventt e;
+					if(eventlog_getcount() == 0) {
+						lcd_gotoxy(0, 0);
+						lcd_puts_p(PSTR("Event Log Empty"));
+					} else if(eventlog_get(eventlog_index, &e)) {
+						lcd_gotoxy(0, 0);
+						lcd_writelong(eventlog_index + 1);
+						lcd_gotoxy(2, 0);
+						eventlog_lcdputtype(e.type);
+						lcd_gotoxy(8, 0);
+						lcd_writelong(e.time);
+
+						lcd_gotoxy(0, 1);
+						lcd_writelong(e.raw);
+						lcd_gotoxy(8, 1);
+						lcd_writelong(e.diff);
+						lcd_gotoxy(14, 1);
+						lcd_writelong(e.errors > 99 ? 99 : e.errors);
+					}
+				}
 
-				uint8_t skip_time = eepromitem_eevar.skip_time;
-				eepromitem_eevar.skip_time = set_plusminus(eepromitem_eevar.skip_time, SKIP_TIME_MAX, SKIP_TIME_MIN);
-				if(skip_time != eepromitem_eevar.skip_time)
+				if(key_getshort(1<<BUTTON_UP) && eventlog_index + 1 < eventlog_getcount()) {
+					eventlog_index++;
+					refreshlcd = 1;
+				}
+				if(key_getshort(1<<BUTTON_DOWN) && eventlog_index > 0) {
+					eventlog_index--;
+					refreshlcd = 1;
+				}
+				break;
+#endif
+
+#if CHARACTERIZE_ENABLED == 1
+			case PROGSTATUS_CHARACTERIZE:
+				//noise characterization
+				if(redraw) {
+					lcd_gotoxy(0, 1);
+					lcd_puts_p(PSTR("Up to start"));
+				}
+
+				if(key_getlong(1<<BUTTON_UP)) {
+					characterize_status = CHARSTATUS_TIME;
+					currentstate = characterize;
 					lcd_clrscr();
+				}
+				break;
+#endif
 			}
 
 			//check change status
@@ -699,15 +2993,49 @@ int main(void) {
 				//refresh lcd
 				refreshlcd = 1;
 
+				recipe_store();
 				eepromitem_eepromwrite();
+#if SPARKLINE_ENABLED == 1
+				sparkline_reset();
+#endif
+
+				//set the rate and measure the period in background
+				hx711_setrate(eepromitem_eevar.weightcal_rate);
+				hx711_measurestart(maintimer_getus);
+#if CHECKWEIGHER_ENABLED == 1
+				eepromcw_clampdelay();
+				eepromcw_eepromwrite();
+
+				//restart capture
+				checkweigher_capturing = 0;
+				checkweigher_triggered = 0;
+				reject_clear();
+				reject_setwidth(MAINTIMER_MS2STEPS(eepromcw_eevar.reject_width));
+				checkweigher_setlockout();
+#endif
+#if FLOWRATE_ENABLED == 1
+				eepromflow_eepromwrite();
+
+				//restart the rate, the total is kept
+				flow_restart();
+				flowrate_sum = 0;
+				flowrate_count = 0;
+				flowrate_rate = 0;
+#endif
+#if KALMAN_ENABLED == 1
+				eepromkf_eepromwrite();
+
+				//new noises and period
+				weight_kalmaninit();
+#endif
 			}
 
 			//check change status
     		if(key_getshort(1<<BUTTON_SELECT)) {
     			programming_status++;
-    			programming_status %= PROGSTATUSTOT;
+    			programming_status %= MENU_PROGITEMSTOT;
 
-    			lcd_clrscr();
+    			refreshlcd = 1;
 			}
 		}
 
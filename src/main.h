@@ -17,9 +17,14 @@ Please refer to LICENSE file for licensing information.
 #include <avr/interrupt.h>
 #include <util/delay.h>
 #include <avr/wdt.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
 #include <avr/eeprom.h>
 #include <avr/pgmspace.h>
 
+//include board definitions
+#include "board/board.h"
+
 //include key lib
 #include "key/key.h"
 
@@ -29,41 +34,217 @@ Please refer to LICENSE file for licensing information.
 //include hx711 lib
 #include "hx711/hx711.h"
 
+//include uart lib
+#include "uart/uart.h"
+
+//include diag lib
+#include "diag/diag.h"
+
+//include eeconf lib
+#include "eeconf/eeconf.h"
+
+//include lincal lib
+#include "lincal/lincal.h"
+
+//include stats lib
+#include "stats/stats.h"
+
+//include noise lib
+#include "noise/noise.h"
+
+//include reject lib
+#include "reject/reject.h"
+
+//include flow lib
+#include "flow/flow.h"
+
+//include eventlog lib
+#include "eventlog/eventlog.h"
+
+//include history lib
+#include "history/history.h"
+
+//include sparkline lib
+#include "sparkline/sparkline.h"
+
+//include kalman lib
+#include "kalman/kalman.h"
+
+//include menu lib
+#include "menu/menu.h"
+
 //define buttons
 #define BUTTON_UP KEY_BUTTON1
 #define BUTTON_DOWN KEY_BUTTON2
 #define BUTTON_SELECT KEY_BUTTON3
 
-//programming status
-#define PROGSTATUS_GETWEIGHTINTERVAL 0
-#define PROGSTATUS_GETWEIGHTTHRESHOLDERR 1
-#define PROGSTATUS_GETWEIGHTTHRESHOLDDIFF 2
-#define PROGSTATUS_TARE 3
-#define PROGSTATUS_ALERTENABLED 4
-#define PROGSTATUS_SKIPINTERVAL 5
-#define PROGSTATUS_SKIPTIME 6
-#define PROGSTATUSTOT 7
-
-//calibration status
+//enable noise characterization
+#define CHARACTERIZE_ENABLED 0
+
+//enable checkweigher mode
+#define CHECKWEIGHER_ENABLED 0
+
+//enable flow rate mode
+#define FLOWRATE_ENABLED 0
+
+//enable production statistics
+#define PRODSTATS_ENABLED 0
+
+//enable eeprom event log
+#define EVENTLOG_ENABLED 0
+
+//enable sample history
+#define HISTORY_ENABLED 0
+
+//enable the running screen sparkline of the weight differences (x1000)
+#define SPARKLINE_ENABLED 0
+
+//enable channel B sampling, interleaved with channel A, bit i of the
+//pattern set reads channel B in slot i of CHANNELB_PATTERNLEN slots,
+//each channel switch costs HX711_SETTLEPERIODS discarded conversions
+#define CHANNELB_ENABLED 0
+#define CHANNELB_PATTERN 0x80
+#define CHANNELB_PATTERNLEN 8
+
+//enable hx711 power down between the weight readings, the converter is
+//powered up ahead of a reading by the settling time and the filter samples
+#define DUTYCYCLE_ENABLED 0
+
+//enable warm restart, resume the running state after a watchdog or
+//brown-out reset
+#define WARMSTART_ENABLED 0
+
+//enable the kalman filter weight check, every conversion is filtered and
+//the diff is the change of the filtered rate over the weight interval, the
+//errors are counted once the filter settled after a restart
+#define KALMAN_ENABLED 0
+#if KALMAN_ENABLED == 1 && DUTYCYCLE_ENABLED == 1
+#error "the kalman filter needs every conversion, disable the duty cycle"
+#endif
+
+//programming pages, the pages are shown in the order of the menu table
+#define PROGSTATUS_RECIPE 0
+#define PROGSTATUS_GETWEIGHTINTERVAL 1
+#define PROGSTATUS_GETWEIGHTTHRESHOLDERR 2
+#define PROGSTATUS_GETWEIGHTTHRESHOLDDIFF 3
+#define PROGSTATUS_TARE 4
+#define PROGSTATUS_ALERTENABLED 5
+#define PROGSTATUS_SKIPINTERVAL 6
+#define PROGSTATUS_SKIPTIME 7
+#define PROGSTATUS_RATE 8
+#define PROGSTATUS_CWENABLED 9
+#define PROGSTATUS_CWSETTLE 10
+#define PROGSTATUS_CWWINDOW 11
+#define PROGSTATUS_CWLOW 12
+#define PROGSTATUS_CWHIGH 13
+#define PROGSTATUS_CWDELAY 14
+#define PROGSTATUS_CWWIDTH 15
+#define PROGSTATUS_FLENABLED 16
+#define PROGSTATUS_FLLOW 17
+#define PROGSTATUS_FLHIGH 18
+#define PROGSTATUS_FLREFILL 19
+#define PROGSTATUS_CHARACTERIZE 20
+#define PROGSTATUS_EVENTLOG 21
+#define PROGSTATUS_HISTORY 22
+#define PROGSTATUS_CHANNELB 23
+#define PROGSTATUS_KFNOISE 24
+#define PROGSTATUS_KFPROCESS 25
+
+//characterization status
+#define CHARSTATUS_TIME 0
+#define CHARSTATUS_UNLOADED 1
+#define CHARSTATUS_LOAD 2
+#define CHARSTATUS_LOADED 3
+#define CHARSTATUS_RESULTUNLOADED 4
+#define CHARSTATUS_RESULTLOADED 5
+#define CHARSTATUS_RESULTADEV 6
+#define CHARSTATUS_RESULTRECOMMEND 7
+
+//calibration pages, the pages are shown in the order of the menu table
 #define CALSTATUS_GAIN 0
 #define CALSTATUS_OFFSET 1
 #define CALSTATUS_WEIGHT 2
 #define CALSTATUS_SCALE 3
-#define CALSTATUSTOT 4
-
-//alarm relay
-#define RELALERT_DDR DDRB
-#define RELALERT_PORT PORTB
-#define RELALERT_PINNUM PB2
-#define RELALERT_OFF RELALERT_PORT |= (1<<RELALERT_PINNUM)
-#define RELALERT_ON RELALERT_PORT &= ~(1<<RELALERT_PINNUM)
-
-//skip relay
-#define RELSKIP_DDR DDRD
-#define RELSKIP_PORT PORTD
-#define RELSKIP_PINNUM PD3
-#define RELSKIP_OFF RELSKIP_PORT |= (1<<RELSKIP_PINNUM)
-#define RELSKIP_ON RELSKIP_PORT &= ~(1<<RELSKIP_PINNUM)
+
+//diagnostics pages
+#define DIAGPAGE_LOOP 0
+#define DIAGPAGE_HX711 1
+#define DIAGPAGE_LCD 2
+#define DIAGPAGE_ISR 3
+#define DIAGPAGE_WDT 4
+#define DIAGPAGE_RAM 5
+#define DIAGPAGE_STACK 6
+#if WARMSTART_ENABLED == 1
+#define DIAGPAGE_RESETS 7
+#define DIAGPAGETOT 8
+#else
+#define DIAGPAGETOT 7
+#endif
+
+//production statistics pages
+#define PRODSTATSPAGE_COUNT 0
+#define PRODSTATSPAGE_WEIGHT 1
+#define PRODSTATSPAGE_WEIGHTMINMAX 2
+#define PRODSTATSPAGE_DIFF 3
+#define PRODSTATSPAGE_DIFFMINMAX 4
+#define PRODSTATSPAGE_HISTOGRAM 5
+#define PRODSTATSPAGETOT 6
+
+//production statistics histogram of the weight diff (x1000), bins start at
+//PRODSTATS_HISTMIN, the outer bins also count the values out of range
+#define PRODSTATS_HISTBINS 8
+#define PRODSTATS_HISTMIN -2000
+#define PRODSTATS_HISTWIDTH 500
+//seconds the snapshot saved message is shown
+#define PRODSTATS_SAVEDTIME 2
+
+//enable telemetry on uart
+#define TELEMETRY_ENABLED 0
+
+//telemetry commands
+#define TELEMETRY_CMDDIAG 'd'
+#define TELEMETRY_CMDEVENTLOG 'l'
+#define TELEMETRY_CMDHISTORY 'h'
+
+//calibration sampler, sampling ends when the standard error of the mean
+//(raw units) is below the target or at max time (seconds)
+#define CALSAMPLER_STDERRTARGET 2
+#define CALSAMPLER_SAMPLESMIN 10
+#define CALSAMPLER_TIMEMAX 30
+//restart sampling if a sample moves more than this from the mean
+#define CALSAMPLER_STEPMAX 100000
+
+//noise characterization, target false alarms rate is one every
+//CHARACTERIZE_FALSEALARMHOURS hours
+#define CHARACTERIZE_FALSEALARMHOURS 1000
+//seconds the applied thresholds message is shown
+#define CHARACTERIZE_APPLIEDTIME 2
+
+//checkweigher item classes
+#define CHECKWEIGHER_CLASSOK 0
+#define CHECKWEIGHER_CLASSUNDER 1
+#define CHECKWEIGHER_CLASSOVER 2
+#define CHECKWEIGHER_CLASSNONE 3 //no samples in the window
+
+//trigger edges within the settle time of the last trigger, and at least
+//within CHECKWEIGHER_DEBOUNCE ms, are bounces and are ignored
+#define CHECKWEIGHER_DEBOUNCE 20
+
+//checkweigher trigger, relays and recipe input pins are set by the
+//board revision, board/board.h
+
+//number of recipes
+#define RECIPE_TOT 4
+
+//recipe select input, active low, the recipe is the binary value of the pins
+#define RECIPE_INPUTENABLED 0
+#define RECIPE_INPUTDEBOUNCE 3 //10ms steps
+
+//value edit acceleration, key repeats in a second and key repeats for each
+//step of the 1 2 5 10 20 50 ... ramp, every field sets the seconds of hold
+//to sweep its range at the top step
+#define SETPLUSMINUS_REPEATSSEC (100/KEY_REPEATNEXT)
+#define SETPLUSMINUS_RAMPREPEATS 5
 
 //max and min weight interval
 #define GETWEIGHT_INTERVAL_MIN 1
@@ -76,19 +257,103 @@ Please refer to LICENSE file for licensing information.
 //max and min weight threshold diff error
 #define GETWEIGHT_THRESHOLDDIFF_MIN -5000
 #define GETWEIGHT_THRESHOLDDIFF_MAX +5000
+#define GETWEIGHT_THRESHOLDDIFF_SWEEP 10
+
+//max and min alert enabled
+#define ALERT_ENABLED_MIN 0
+#define ALERT_ENABLED_MAX 1
 
 //max and min calibration weight
 #define WEIGHTCAL_WEIGHT_MIN 1
 #define WEIGHTCAL_WEIGHT_MAX 100
 
+//max and min calibration offset, the hx711 output is 24 bits
+#define WEIGHTCAL_OFFSET_MIN 0
+#define WEIGHTCAL_OFFSET_MAX 0xFFFFFF
+
+//max and min calibration gain, channel B gain 32 in between is not valid
+#define WEIGHTCAL_GAIN_MIN HX711_GAINCHANNELA128
+#define WEIGHTCAL_GAIN_MAX HX711_GAINCHANNELA64
+
+//max and min hx711 rate
+#define WEIGHTCAL_RATE_MIN HX711_RATE10SPS
+#define WEIGHTCAL_RATE_MAX HX711_RATE80SPS
+
 //max and min skip interval
 #define SKIP_INTERVAL_MIN 0
 #define SKIP_INTERVAL_MAX 1440
+#define SKIP_INTERVAL_SWEEP 6
 
 //max and min skip time
 #define SKIP_TIME_MIN 1
 #define SKIP_TIME_MAX 60
 
+//max and min characterization time in sec
+#define CHARACTERIZE_TIME_MIN 10
+#define CHARACTERIZE_TIME_MAX 600
+#define CHARACTERIZE_TIME_SWEEP 6
+
+//max and min checkweigher mode enabled
+#define CHECKWEIGHER_ENABLED_MIN 0
+#define CHECKWEIGHER_ENABLED_MAX 1
+
+//max and min checkweigher settle delay in ms
+#define CHECKWEIGHER_SETTLE_MIN 0
+#define CHECKWEIGHER_SETTLE_MAX 5000
+#define CHECKWEIGHER_SETTLE_SWEEP 5
+
+//max and min checkweigher capture window in ms, from the trigger
+#define CHECKWEIGHER_WINDOW_MIN 10
+#define CHECKWEIGHER_WINDOW_MAX 10000
+#define CHECKWEIGHER_WINDOW_SWEEP 10
+
+//max and min checkweigher band limits (x1000)
+#define CHECKWEIGHER_BAND_MIN 0
+#define CHECKWEIGHER_BAND_MAX 65000
+
+//max and min flow rate mode enabled
+#define FLOWRATE_ENABLED_MIN 0
+#define FLOWRATE_ENABLED_MAX 1
+
+//max and min flow rate band limits, units per minute (x1000)
+#define FLOWRATE_BAND_MIN 0
+#define FLOWRATE_BAND_MAX 65000
+
+//max and min flow rate refill step (x1000)
+#define FLOWRATE_REFILL_MIN 1
+#define FLOWRATE_REFILL_MAX 65000
+#define FLOWRATE_REFILL_SWEEP 10
+
+//max and min reject delay in ms, from the trigger, the delay is raised to
+//the capture window plus REJECT_DELAY_MARGIN, the item is classified at the
+//end of its window
+#define REJECT_DELAY_MIN 0
+#define REJECT_DELAY_MAX 60000
+#define REJECT_DELAY_MARGIN 50
+#define REJECT_DELAY_SWEEP 10
+
+//max and min reject pulse width in ms
+#define REJECT_WIDTH_MIN 10
+#define REJECT_WIDTH_MAX 2000
+#define REJECT_WIDTH_SWEEP 5
+
+//max and min kalman measurement noise, standard deviation (x1000)
+#define KALMAN_NOISE_MIN 1
+#define KALMAN_NOISE_MAX 65000
+#define KALMAN_NOISE_SWEEP 10
+
+//max and min kalman process noise, rate change in a second, units per
+//second (x1000)
+#define KALMAN_PROCESS_MIN 1
+#define KALMAN_PROCESS_MAX 65000
+#define KALMAN_PROCESS_SWEEP 10
+
+//eeprom layout version
+#define EEPROMITEM_VERSION 3
+
+//eeprom layout 1 size
+#define EEPROMITEM_V1SIZE 21
+
 //enabled alert
 #define ALERT_ENABLED_DEFAULT 0
 
@@ -116,9 +381,50 @@ Please refer to LICENSE file for licensing information.
 //default skip time
 #define SKIP_TIME_DEFAULT 2
 
+//default characterization time in sec
+#define CHARACTERIZE_TIME_DEFAULT 60
+
+//default checkweigher mode enabled
+#define CHECKWEIGHER_ENABLED_DEFAULT 0
+
+//default checkweigher settle delay in ms
+#define CHECKWEIGHER_SETTLE_DEFAULT 200
+
+//default checkweigher capture window in ms
+#define CHECKWEIGHER_WINDOW_DEFAULT 800
+
+//default checkweigher band (x1000)
+#define CHECKWEIGHER_LOW_DEFAULT 9500
+#define CHECKWEIGHER_HIGH_DEFAULT 10500
+
+//default flow rate mode enabled
+#define FLOWRATE_ENABLED_DEFAULT 0
+
+//default flow rate band, units per minute (x1000)
+#define FLOWRATE_LOW_DEFAULT 500
+#define FLOWRATE_HIGH_DEFAULT 2000
+
+//default flow rate refill step (x1000)
+#define FLOWRATE_REFILL_DEFAULT 1000
+
+//default reject delay in ms
+#define REJECT_DELAY_DEFAULT 1000
+
+//default reject pulse width in ms
+#define REJECT_WIDTH_DEFAULT 100
+
 //default calibration gain
 #define WEIGHTCAL_GAIN_DEFAULT HX711_GAINDEFAULT
 
+//default hx711 rate
+#define WEIGHTCAL_RATE_DEFAULT HX711_RATEDEFAULT
+
+//default kalman measurement noise (x1000)
+#define KALMAN_NOISE_DEFAULT 20
+
+//default kalman process noise (x1000)
+#define KALMAN_PROCESS_DEFAULT 10
+
 
 //main timer setting
 //freq = FCPU / (prescale * (256 - preload))
@@ -130,6 +436,10 @@ Please refer to LICENSE file for licensing information.
 #define MAINTIMER_10MSSTEP 5
 //step to count 1000 ms
 #define MAINTIMER_1000MSSTEP 488
+//ms to timer steps
+#define MAINTIMER_MS2STEPS(ms) ((uint32_t)(ms)*MAINTIMER_1000MSSTEP/1000)
+//timer count (us), prescale / FCPU
+#define MAINTIMER_TICKUS (64000000UL/F_CPU)
 //timer interrupt
 #define MAINTIMER_INTERRUPT ISR(TIMER0_OVF_vect) 
 //timer init
@@ -0,0 +1,156 @@
+/*
+menu lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+*/
+
+
+#include "menu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "../key/key.h"
+#include "../lcd/lcd.h"
+
+
+//step function of the accelerated fields
+static int32_t (*menu_plusminus)(int32_t n, int32_t max, int32_t min, uint8_t sweep) = NULL;
+
+//edited digit of a digit field, the digit is reset when the field changes
+static uint8_t menu_digit = 0;
+static void *menu_digitfield = NULL;
+
+/**
+ * print a number
+ */
+static void menu_lcdwritelong(int32_t n) {
+	char tnum[11];
+	ltoa(n, tnum, 10);
+	lcd_puts(tnum);
+}
+
+/**
+ * get the place value of a digit
+ */
+static int32_t menu_getplace(uint8_t digit) {
+	int32_t place = 1;
+	while(digit--)
+		place *= 10;
+	return place;
+}
+
+/**
+ * get a menu item, the item is copied from flash, the field of a per recipe
+ * item is the one of the recipe
+ */
+void menu_getitem(const menu_itemt *items, uint8_t index, menu_itemt *item, uint8_t recipe) {
+	memcpy_P(item, &items[index], sizeof(menu_itemt));
+	if(item->stride)
+		item->field = (uint8_t *)item->field + item->stride*recipe;
+}
+
+/**
+ * get the value of a menu item field
+ */
+int32_t menu_getvalue(const menu_itemt *item) {
+	if(item->type == MENU_TYPEUINT16)
+		return *(uint16_t *)item->field;
+	else if(item->type == MENU_TYPEINT16)
+		return *(int16_t *)item->field;
+	else
+		return *(uint8_t *)item->field;
+}
+
+/**
+ * edit a menu item field, return 1 if the value or the edited digit changed
+ */
+uint8_t menu_edit(const menu_itemt *item) {
+	if(item->type == MENU_TYPEPAGE)
+		return 0;
+
+	int32_t value = menu_getvalue(item);
+	int32_t n = value;
+	if(item->type == MENU_TYPEONOFF) {
+		if(key_getshort(1<<MENU_KEYUP))
+			n = item->max;
+		if(key_getshort(1<<MENU_KEYDOWN))
+			n = item->min;
+	} else if(item->step == MENU_STEPDIGIT) {
+		if(item->field != menu_digitfield) {
+			menu_digitfield = item->field;
+			menu_digit = 0;
+		}
+		//select the digit, long up the next higher, long down the next lower, up to the range
+		if(key_getlong(1<<MENU_KEYUP)) {
+			menu_digit++;
+			if(menu_getplace(menu_digit) > item->max - item->min)
+				menu_digit = 0;
+			return 1;
+		}
+		if(key_getlong(1<<MENU_KEYDOWN)) {
+			if(menu_digit > 0)
+				menu_digit--;
+			else
+				while(menu_getplace(menu_digit + 1) <= item->max - item->min)
+					menu_digit++;
+			return 1;
+		}
+		//change the digit, clamped to the limits
+		int32_t place = menu_getplace(menu_digit);
+		if(key_getshort(1<<MENU_KEYUP))
+			n = (n > item->max - place ? item->max : n + place);
+		if(key_getshort(1<<MENU_KEYDOWN))
+			n = (n < item->min + place ? item->min : n - place);
+	} else if(menu_plusminus) {
+		n = menu_plusminus(value, item->max, item->min, item->step);
+	}
+	if(n == value)
+		return 0;
+
+	if(item->type == MENU_TYPEUINT16)
+		*(uint16_t *)item->field = n;
+	else if(item->type == MENU_TYPEINT16)
+		*(int16_t *)item->field = n;
+	else
+		*(uint8_t *)item->field = n;
+	return 1;
+}
+
+/**
+ * draw a menu item, the label on the first row and the field value on the second
+ */
+void menu_lcdprint(const menu_itemt *item) {
+	lcd_clrscr();
+	lcd_gotoxy(0, 0);
+	lcd_puts(item->label);
+
+	if(item->type == MENU_TYPEONOFF) {
+		lcd_gotoxy(13, 1);
+		if(menu_getvalue(item))
+			lcd_puts_p(PSTR(" On"));
+		else
+			lcd_puts_p(PSTR("Off"));
+	} else if(item->type != MENU_TYPEPAGE) {
+		lcd_gotoxy(0, 1);
+		menu_lcdwritelong(menu_getvalue(item));
+		//place of the edited digit
+		if(item->step == MENU_STEPDIGIT) {
+			lcd_gotoxy(10, 1);
+			lcd_puts_p(PSTR("x"));
+			menu_lcdwritelong(menu_getplace(item->field == menu_digitfield ? menu_digit : 0));
+		}
+	}
+}
+
+/**
+ * init the menu, plusminus steps the accelerated fields
+ */
+void menu_init(int32_t (*plusminus)(int32_t n, int32_t max, int32_t min, uint8_t sweep)) {
+	menu_plusminus = plusminus;
+}
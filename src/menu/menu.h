@@ -0,0 +1,64 @@
+/*
+menu lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + a menu is a PROGMEM table of items, one for each page, the page
+    position is the table index, an item has a label, a field pointer,
+    a type, a step policy and the field limits
+  + menu_getitem() copies an item from flash, a field with a stride is
+    an array of per recipe fields, the field of the given recipe is taken
+  + menu_edit() changes a field by the up and down keys, on/off fields are
+    set by short presses, digit fields change the selected digit and long
+    presses select it, the other fields are stepped by the function given
+    to menu_init(), accelerated by the hold time
+  + menu_lcdprint() draws the label on the first row and the value on the
+    second, page items are drawn and edited by their handlers
+*/
+
+#include <avr/io.h>
+
+
+#ifndef MENU_H_
+#define MENU_H_
+
+
+//item types
+#define MENU_TYPEPAGE 0 //custom page, drawn and edited by its handler
+#define MENU_TYPEUINT8 1
+#define MENU_TYPEUINT16 2
+#define MENU_TYPEINT16 3
+#define MENU_TYPEONOFF 4 //uint8_t switch, short up on, short down off
+
+//step policies, other values are the sweep seconds of an accelerated field
+#define MENU_STEPSINGLE 0 //one unit for each press and repeat
+#define MENU_STEPDIGIT 0xFF //short up and down change a digit, long up and down select the digit
+
+//keys, as the up and down buttons of main
+#define MENU_KEYUP KEY_BUTTON1
+#define MENU_KEYDOWN KEY_BUTTON2
+
+//item
+typedef struct {
+	uint8_t id;
+	char label[17];
+	void *field;
+	uint8_t stride; //field size of each recipe, 0 if the field is not set by recipe
+	uint8_t type;
+	uint8_t step; //step policy
+	int32_t min;
+	int32_t max;
+} menu_itemt;
+
+//functions
+extern void menu_init(int32_t (*plusminus)(int32_t n, int32_t max, int32_t min, uint8_t sweep));
+extern void menu_getitem(const menu_itemt *items, uint8_t index, menu_itemt *item, uint8_t recipe);
+extern int32_t menu_getvalue(const menu_itemt *item);
+extern uint8_t menu_edit(const menu_itemt *item);
+extern void menu_lcdprint(const menu_itemt *item);
+
+#endif
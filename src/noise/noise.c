@@ -0,0 +1,129 @@
+/*
+noise lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+References:
+  + Abramowitz and Stegun, Handbook of Mathematical Functions, 26.2.23
+*/
+
+
+#include "noise.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <avr/io.h>
+
+#include "../stats/stats.h"
+
+
+//interval means fractional bits
+#define NOISE_BLOCKSHIFT 4
+
+//all samples
+static stats_t noise_samples;
+//differences of consecutive interval means
+static stats_t noise_blocks;
+//differences of the last samples of consecutive intervals
+static stats_t noise_diffs;
+
+//current interval accumulator
+static int64_t noise_blocksum = 0;
+static uint16_t noise_blockcount = 0;
+
+//previous interval
+static int32_t noise_lastblockmean = 0;
+static int32_t noise_lastsample = 0;
+static uint8_t noise_lastvalid = 0;
+
+//last sample read
+static int32_t noise_sample = 0;
+
+/**
+ * reset the accumulators
+ */
+void noise_reset() {
+	stats_reset(&noise_samples);
+	stats_reset(&noise_blocks);
+	stats_reset(&noise_diffs);
+	noise_blocksum = 0;
+	noise_blockcount = 0;
+	noise_lastvalid = 0;
+}
+
+/**
+ * add a sample
+ */
+void noise_addsample(int32_t raw) {
+	stats_add(&noise_samples, raw);
+	noise_blocksum += raw;
+	noise_blockcount++;
+	noise_sample = raw;
+}
+
+/**
+ * close the current interval
+ */
+void noise_interval() {
+	int32_t blockmean = 0;
+
+	if(noise_blockcount == 0)
+		return;
+
+	blockmean = (noise_blocksum<<NOISE_BLOCKSHIFT)/noise_blockcount;
+	if(noise_lastvalid) {
+		stats_add(&noise_blocks, blockmean - noise_lastblockmean);
+		stats_add(&noise_diffs, noise_sample - noise_lastsample);
+	}
+	noise_lastblockmean = blockmean;
+	noise_lastsample = noise_sample;
+	noise_lastvalid = 1;
+
+	noise_blocksum = 0;
+	noise_blockcount = 0;
+}
+
+/**
+ * get the results
+ */
+void noise_getresult(noise_resultt *r) {
+	double blockmean = 0;
+	double blockvar = 0;
+
+	r->stddev = stats_getstddev(&noise_samples);
+	r->peaktopeak = noise_samples.max - noise_samples.min;
+
+	//allan variance is half the mean square difference of consecutive interval means
+	r->allandev = 0;
+	if(noise_blocks.n) {
+		blockmean = (double)stats_getmean(&noise_blocks);
+		blockvar = stats_getvariance(&noise_blocks)*(double)(noise_blocks.n - 1)/(double)noise_blocks.n;
+		r->allandev = sqrt((blockvar + blockmean*blockmean)/2.0)/(1<<NOISE_BLOCKSHIFT);
+	}
+
+	r->diffmean = 0;
+	if(noise_diffs.n)
+		r->diffmean = stats_getmean(&noise_diffs);
+	r->diffstddev = stats_getstddev(&noise_diffs);
+
+	r->enob = NOISE_ADCBITS;
+	if(r->stddev > 1)
+		r->enob -= log(r->stddev)/log(2.0);
+}
+
+/**
+ * inverse of the normal upper tail probability, k such that P(X > k sigma) = p
+ */
+double noise_qinv(double p) {
+	double t = 0;
+
+	if(p >= 0.5)
+		return 0;
+	if(p <= 0)
+		p = 1e-30;
+	t = sqrt(-2.0*log(p));
+	return t - (2.515517 + 0.802853*t + 0.010328*t*t)/(1.0 + 1.432788*t + 0.189269*t*t + 0.001308*t*t*t);
+}
@@ -0,0 +1,45 @@
+/*
+noise lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + streaming noise characterization of raw samples, constant memory
+  + noise_interval() must be called at every weighing interval, at each
+    interval the mean of the samples read in the interval (Allan deviation)
+    and the last sample (difference seen by the weight check) are compared
+    with the ones of the previous interval
+  + all results are in raw units
+*/
+
+#include <avr/io.h>
+
+
+#ifndef NOISE_H_
+#define NOISE_H_
+
+
+//adc bits
+#define NOISE_ADCBITS 24
+
+//results
+typedef struct {
+	double stddev;
+	double peaktopeak;
+	double allandev;
+	double diffmean;
+	double diffstddev;
+	double enob;
+} noise_resultt;
+
+//functions
+extern void noise_reset();
+extern void noise_addsample(int32_t raw);
+extern void noise_interval();
+extern void noise_getresult(noise_resultt *r);
+extern double noise_qinv(double p);
+
+#endif
@@ -0,0 +1,107 @@
+/*
+reject lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+*/
+
+
+#include "reject.h"
+
+#include <stdio.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+
+//queue index mask
+#define REJECT_QUEUEMASK (REJECT_QUEUESIZE-1)
+
+//queued steps, sorted from the head
+static volatile uint32_t reject_queue[REJECT_QUEUESIZE];
+static volatile uint8_t reject_head = 0;
+static volatile uint8_t reject_count = 0;
+
+//pulse
+static uint16_t reject_width = 1;
+static volatile uint16_t reject_pulse = 0;
+
+/**
+ * set the pulse width in timer steps
+ */
+void reject_setwidth(uint16_t steps) {
+	if(steps == 0)
+		steps = 1;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		reject_width = steps;
+	}
+}
+
+/**
+ * queue a reject at step, return 0 if the queue is full
+ */
+uint8_t reject_push(uint32_t step) {
+	uint8_t ret = 0;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if(reject_count < REJECT_QUEUESIZE) {
+			//insert from the tail, moving later events back
+			uint8_t i = reject_count;
+			while(i > 0) {
+				uint32_t prev = reject_queue[(reject_head + i - 1) & REJECT_QUEUEMASK];
+				if((int32_t)(step - prev) >= 0)
+					break;
+				reject_queue[(reject_head + i) & REJECT_QUEUEMASK] = prev;
+				i--;
+			}
+			reject_queue[(reject_head + i) & REJECT_QUEUEMASK] = step;
+			reject_count++;
+			ret = 1;
+		}
+	}
+	return ret;
+}
+
+/**
+ * get the number of queued rejects
+ */
+uint8_t reject_getcount() {
+	return reject_count;
+}
+
+/**
+ * clear the queue, the running pulse ends at its time
+ */
+void reject_clear() {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		reject_count = 0;
+	}
+}
+
+/**
+ * timer interrupt, return the pulse edge
+ */
+uint8_t reject_timerinterrupt(uint32_t now) {
+	uint8_t ret = REJECT_PULSENONE;
+
+	//end the pulse
+	if(reject_pulse) {
+		reject_pulse--;
+		if(reject_pulse == 0)
+			ret = REJECT_PULSEEND;
+	}
+
+	//fire the head, older events fire late rather than never
+	while(reject_count && (int32_t)(now - reject_queue[reject_head]) >= 0) {
+		reject_head = (reject_head + 1) & REJECT_QUEUEMASK;
+		reject_count--;
+		if(reject_pulse == 0)
+			ret = REJECT_PULSESTART;
+		reject_pulse = reject_width;
+	}
+
+	return ret;
+}
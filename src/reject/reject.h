@@ -0,0 +1,40 @@
+/*
+reject lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + reject events are queued with the timer step they must fire at, the
+    queue is a ring kept sorted by insertion, so the timer interrupt only
+    checks the head and the pulse starts at the exact step
+  + reject_timerinterrupt() must be called at every timer step, it returns
+    the pulse edges, a reject firing during a pulse extends it
+  + steps wrap around, delays must be shorter than 2^31 steps
+*/
+
+#include <avr/io.h>
+
+
+#ifndef REJECT_H_
+#define REJECT_H_
+
+
+//queue size, power of 2
+#define REJECT_QUEUESIZE 16
+
+//pulse edges
+#define REJECT_PULSENONE 0
+#define REJECT_PULSESTART 1
+#define REJECT_PULSEEND 2
+
+//functions
+extern void reject_setwidth(uint16_t steps);
+extern uint8_t reject_push(uint32_t step);
+extern uint8_t reject_getcount();
+extern void reject_clear();
+extern uint8_t reject_timerinterrupt(uint32_t now);
+
+#endif
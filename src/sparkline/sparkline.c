@@ -0,0 +1,164 @@
+/*
+sparkline lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+*/
+
+
+#include "sparkline.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+
+#include "../lcd/lcd.h"
+
+
+//column min and max
+typedef struct {
+	int16_t min;
+	int16_t max;
+} sparkline_colt;
+
+//ring of columns, newest column and columns count
+static sparkline_colt sparkline_cols[SPARKLINE_COLS];
+static uint8_t sparkline_head = 0;
+static uint8_t sparkline_count = 0;
+
+//samples of the newest column
+static uint8_t sparkline_colsamples = 0;
+
+//bitmaps of the glyphs on the lcd, bit set for each glyph written
+static uint8_t sparkline_bitmap[SPARKLINE_GLYPHS][8];
+static uint8_t sparkline_written = 0;
+
+//glyph checked first by the next update
+static uint8_t sparkline_next = 0;
+
+//vertical scale of the glyphs on the lcd
+static int32_t sparkline_base = 0;
+static int32_t sparkline_span = 0;
+
+/**
+ * get the bar level of a value, 0 to 7
+ */
+static uint8_t sparkline_level(int16_t x, int32_t base, int32_t span) {
+	return (uint8_t)((((int32_t)x - base) * 7) / span);
+}
+
+/**
+ * clear the columns, the glyphs are blanked by the next updates
+ */
+void sparkline_reset() {
+	sparkline_head = 0;
+	sparkline_count = 0;
+	sparkline_colsamples = 0;
+}
+
+/**
+ * add a sample
+ */
+void sparkline_add(int32_t x) {
+	if(x > INT16_MAX)
+		x = INT16_MAX;
+	else if(x < INT16_MIN)
+		x = INT16_MIN;
+
+	if(sparkline_colsamples == 0) {
+		//new column
+		if(sparkline_count)
+			sparkline_head = (sparkline_head + 1) % SPARKLINE_COLS;
+		if(sparkline_count < SPARKLINE_COLS)
+			sparkline_count++;
+		sparkline_cols[sparkline_head].min = x;
+		sparkline_cols[sparkline_head].max = x;
+	} else {
+		if(x < sparkline_cols[sparkline_head].min)
+			sparkline_cols[sparkline_head].min = x;
+		if(x > sparkline_cols[sparkline_head].max)
+			sparkline_cols[sparkline_head].max = x;
+	}
+
+	sparkline_colsamples++;
+	if(sparkline_colsamples >= SPARKLINE_COLSAMPLES)
+		sparkline_colsamples = 0;
+}
+
+/**
+ * write the changed glyphs to the lcd cgram, within the glyph budget, all of
+ * them on a scale change, return the number of glyphs written
+ */
+uint8_t sparkline_update() {
+	uint8_t i = 0;
+
+	//vertical scale of the shown columns
+	int16_t lo = INT16_MAX;
+	int16_t hi = INT16_MIN;
+	for(i = 0; i < sparkline_count; i++) {
+		if(sparkline_cols[i].min < lo)
+			lo = sparkline_cols[i].min;
+		if(sparkline_cols[i].max > hi)
+			hi = sparkline_cols[i].max;
+	}
+	int32_t base = lo;
+	int32_t span = (int32_t)hi - lo;
+	if(span < SPARKLINE_MINSPAN) {
+		base -= (SPARKLINE_MINSPAN - span)/2;
+		span = SPARKLINE_MINSPAN;
+	}
+
+	//a new scale repaints every glyph at once, so two scales are never shown
+	uint8_t budget = SPARKLINE_GLYPHBUDGET;
+	if(base != sparkline_base || span != sparkline_span) {
+		sparkline_base = base;
+		sparkline_span = span;
+		budget = SPARKLINE_GLYPHS;
+	}
+
+	uint8_t written = 0;
+	uint8_t n = 0;
+	for(n = 0; n < SPARKLINE_GLYPHS && written < budget; n++) {
+		uint8_t glyph = (sparkline_next + n) % SPARKLINE_GLYPHS;
+
+		//bitmap, row 0 on top
+		uint8_t rows[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+		uint8_t x = 0;
+		for(x = 0; x < 5; x++) {
+			//age of the column, 0 is the newest on the right
+			uint8_t age = SPARKLINE_COLS-1 - (glyph*5 + x);
+			if(age >= sparkline_count)
+				continue;
+			sparkline_colt *col = &sparkline_cols[(sparkline_head + SPARKLINE_COLS - age) % SPARKLINE_COLS];
+			uint8_t l = sparkline_level(col->min, base, span);
+			uint8_t lmax = sparkline_level(col->max, base, span);
+			for(; l <= lmax; l++)
+				rows[7 - l] |= 0x10 >> x;
+		}
+
+		//write the glyph if it changed
+		if((sparkline_written & (1<<glyph)) && memcmp(rows, sparkline_bitmap[glyph], 8) == 0)
+			continue;
+		lcd_command((1<<LCD_CGRAM) | (glyph<<3));
+		for(i = 0; i < 8; i++)
+			lcd_data(rows[i]);
+		memcpy(sparkline_bitmap[glyph], rows, 8);
+		sparkline_written |= (1<<glyph);
+		written++;
+	}
+	//start from the first glyph not checked
+	sparkline_next = (sparkline_next + n) % SPARKLINE_GLYPHS;
+
+	return written;
+}
+
+/**
+ * print the sparkline glyphs at the lcd position
+ */
+void sparkline_lcdprint() {
+	uint8_t glyph = 0;
+	for(glyph = 0; glyph < SPARKLINE_GLYPHS; glyph++)
+		lcd_putc(glyph);
+}
@@ -0,0 +1,48 @@
+/*
+sparkline lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + the sparkline is drawn with the 8 HD44780 custom glyphs, 5 pixel
+    columns for each glyph, 40 columns, the newest on the right
+  + a column keeps the min and max of SPARKLINE_COLSAMPLES samples and is
+    drawn as a bar between them, the vertical scale fits the min and max
+    of the shown columns, at least SPARKLINE_MINSPAN
+  + the bitmap of each glyph on the lcd is kept (64 bytes of ram),
+    sparkline_update() rewrites only the glyphs that changed, at most
+    SPARKLINE_GLYPHBUDGET glyphs for each call, the others are written by
+    the next calls, a scale change rewrites all of them in one call
+  + the lcd address is left in the cgram, set the position after an update
+*/
+
+#include <avr/io.h>
+
+
+#ifndef SPARKLINE_H_
+#define SPARKLINE_H_
+
+
+//columns, 5 for each glyph
+#define SPARKLINE_GLYPHS 8
+#define SPARKLINE_COLS (SPARKLINE_GLYPHS*5)
+
+//samples for each column
+#define SPARKLINE_COLSAMPLES 4
+
+//min vertical span, sample units
+#define SPARKLINE_MINSPAN 8
+
+//glyphs written for each update, 9 lcd writes for each glyph
+#define SPARKLINE_GLYPHBUDGET 4
+
+//functions
+extern void sparkline_reset();
+extern void sparkline_add(int32_t x);
+extern uint8_t sparkline_update();
+extern void sparkline_lcdprint();
+
+#endif
@@ -0,0 +1,95 @@
+/*
+stats lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+*/
+
+
+#include "stats.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <avr/io.h>
+
+
+/**
+ * reset the accumulator
+ */
+void stats_reset(stats_t *s) {
+	memset(s, 0, sizeof(stats_t));
+}
+
+/**
+ * add a sample
+ */
+void stats_add(stats_t *s, int32_t x) {
+	int64_t xq = 0;
+	int64_t delta = 0;
+
+	if(s->n == 0) {
+		s->origin = x;
+		s->min = x;
+		s->max = x;
+	}
+	if(x < s->min)
+		s->min = x;
+	if(x > s->max)
+		s->max = x;
+
+	s->n++;
+	xq = (int64_t)(x - s->origin)<<STATS_MEANSHIFT;
+	delta = xq - s->mean;
+	s->mean += delta / (int32_t)s->n;
+	s->m2 += (delta * (xq - s->mean))>>STATS_MEANSHIFT;
+}
+
+/**
+ * set the accumulator from a summary, adding samples continues from it
+ */
+void stats_set(stats_t *s, uint32_t n, int32_t mean, double variance, int32_t min, int32_t max) {
+	stats_reset(s);
+	if(n == 0)
+		return;
+	s->n = n;
+	s->origin = mean;
+	s->min = min;
+	s->max = max;
+	if(n > 1)
+		s->m2 = (int64_t)(variance*(double)(n - 1)*(1<<STATS_MEANSHIFT));
+}
+
+/**
+ * get the mean, rounded
+ */
+int32_t stats_getmean(const stats_t *s) {
+	return s->origin + (int32_t)((s->mean + (1<<(STATS_MEANSHIFT-1)))>>STATS_MEANSHIFT);
+}
+
+/**
+ * get the sample variance
+ */
+double stats_getvariance(const stats_t *s) {
+	if(s->n < 2)
+		return 0;
+	return ((double)s->m2/(1<<STATS_MEANSHIFT))/(double)(s->n - 1);
+}
+
+/**
+ * get the sample standard deviation
+ */
+double stats_getstddev(const stats_t *s) {
+	return sqrt(stats_getvariance(s));
+}
+
+/**
+ * get the standard error of the mean
+ */
+double stats_getstderr(const stats_t *s) {
+	if(s->n < 2)
+		return 0;
+	return sqrt(stats_getvariance(s)/(double)s->n);
+}
@@ -0,0 +1,47 @@
+/*
+stats lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+
+Notes:
+  + streaming mean and variance with the Welford algorithm, constant memory
+  + samples are accumulated relative to the first one (origin), the mean is
+    kept in 64 bits fixed point with STATS_MEANSHIFT fractional bits, the sum
+    of squared deviations in 64 bits
+  + the sum of squared deviations holds 2^(63-2*(bits+STATS_MEANSHIFT))
+    samples deviating bits from the origin, plenty for noise around a load
+*/
+
+#include <avr/io.h>
+
+
+#ifndef STATS_H_
+#define STATS_H_
+
+
+//mean fractional bits
+#define STATS_MEANSHIFT 4
+
+//accumulator
+typedef struct {
+	uint32_t n;
+	int32_t origin;
+	int32_t min;
+	int32_t max;
+	int64_t mean;
+	int64_t m2;
+} stats_t;
+
+//functions
+extern void stats_reset(stats_t *s);
+extern void stats_add(stats_t *s, int32_t x);
+extern void stats_set(stats_t *s, uint32_t n, int32_t mean, double variance, int32_t min, int32_t max);
+extern int32_t stats_getmean(const stats_t *s);
+extern double stats_getvariance(const stats_t *s);
+extern double stats_getstddev(const stats_t *s);
+extern double stats_getstderr(const stats_t *s);
+
+#endif
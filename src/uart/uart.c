@@ -0,0 +1,73 @@
+/*
+uart lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+*/
+
+
+#include "uart.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+
+/**
+ * send a char, wait for the transmit buffer to be empty
+ */
+void uart_putc(char c) {
+	while(!(UCSRA & (1<<UDRE)));
+	UDR = c;
+}
+
+/**
+ * send a string
+ */
+void uart_puts(const char *s) {
+	while(*s)
+		uart_putc(*s++);
+}
+
+/**
+ * send a string from program memory
+ */
+void uart_puts_p(const char *progmem_s) {
+	char c;
+	while((c = pgm_read_byte(progmem_s++)))
+		uart_putc(c);
+}
+
+/**
+ * send a number
+ */
+void uart_putlong(int32_t n) {
+	char tnum[12];
+	ltoa(n, tnum, 10);
+	uart_puts(tnum);
+}
+
+/**
+ * get a char, return -1 if no char is available
+ */
+int16_t uart_getc() {
+	if(!(UCSRA & (1<<RXC)))
+		return -1;
+	return UDR;
+}
+
+/**
+ * initialize uart
+ */
+void uart_init() {
+	//set baudrate
+	UBRRH = (uint8_t)(UART_UBRR>>8);
+	UBRRL = (uint8_t)UART_UBRR;
+	//enable rx and tx
+	UCSRB = (1<<RXEN) | (1<<TXEN);
+	//8 data bits, 1 stop bit, no parity
+	UCSRC = (1<<URSEL) | (1<<UCSZ1) | (1<<UCSZ0);
+}
@@ -0,0 +1,29 @@
+/*
+uart lib 0x01
+
+copyright (c) Davide Gironi, 2021
+
+Released under GPLv3.
+Please refer to LICENSE file for licensing information.
+*/
+
+#include <avr/io.h>
+
+
+#ifndef UART_H_
+#define UART_H_
+
+
+//set baudrate
+#define UART_BAUD 38400
+#define UART_UBRR ((F_CPU/(16UL*UART_BAUD))-1)
+
+//functions
+extern void uart_init();
+extern void uart_putc(char c);
+extern void uart_puts(const char *s);
+extern void uart_puts_p(const char *progmem_s);
+extern void uart_putlong(int32_t n);
+extern int16_t uart_getc();
+
+#endif